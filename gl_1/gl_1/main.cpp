@@ -9,6 +9,7 @@
 #include <GLFW/glfw3.h>
 
 #include "clock.hpp"
+#include "benchmark.hpp"
 
 using namespace cg;
 
@@ -22,10 +23,13 @@ const float COLOR_CHANGE_SPEED = 0.1f;
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
-int main()
+int main(int argc, char* argv[])
 {
+	// headless run of a fixed number of frames with --benchmark
+	Benchmark benchmark(argc, argv, "gl_1");
+
 	// init GLFW, set GL version & pipeline info
-	glfwInit();
+	benchmark.Init();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -51,6 +55,10 @@ int main()
 		glfwTerminate();
 		return -2;
 	}
+	if (!benchmark.Attach(window)) {
+		glfwTerminate();
+		return -2;
+	}
 
 	GLfloat red = 0.2f;
 	GLfloat green = 0.3f;
@@ -60,26 +68,29 @@ int main()
 	my_clock.reset();
 
 	// update loop
-	while (glfwWindowShouldClose(window) == 0) {
+	while (benchmark.Running(window)) {
 		// check event queue
+		benchmark.Phase("Events");
 		glfwPollEvents();
 
 		// your update code here
 		my_clock.lap();
-		double time_delta = my_clock.elapsedSecond();
+		double time_delta = benchmark.Delta(my_clock.elapsedSecond());
 
 		red = modf(red + COLOR_CHANGE_SPEED * time_delta, &tmp);
 		green = modf(green + COLOR_CHANGE_SPEED * time_delta * 0.85, &tmp);
 		blue = modf(blue + COLOR_CHANGE_SPEED * time_delta * 0.75, &tmp);
 	
 		// drawing
+		benchmark.Phase("Draw");
 		glClearColor(red, green, blue, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		// swap buffer
-		glfwSwapBuffers(window);
+		benchmark.SwapBuffers(window);
 	}
 
+	benchmark.Report();
 	glfwTerminate();
 	return 0;
 }
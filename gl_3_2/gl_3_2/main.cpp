@@ -8,6 +8,7 @@
 #include <GLFW/glfw3.h>
 
 #include "shader_loader.hpp"
+#include "benchmark.hpp"
 
 using namespace cg;
 
@@ -30,12 +31,15 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 // install Shaders from files
 const GLuint installShaderProgram(const std::string& vertexFilename, const std::string& fragmentFilename);
 
-int main()
+int main(int argc, char* argv[])
 {
+	// headless run of a fixed number of frames with --benchmark
+	Benchmark benchmark(argc, argv, "gl_3_2");
+
 	// Setup a GLFW window
 
 	// init GLFW, set GL version & pipeline info
-	glfwInit();
+	benchmark.Init();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -65,6 +69,10 @@ int main()
 		glfwTerminate();
 		return -2;
 	}
+	if (!benchmark.Attach(window)) {
+		glfwTerminate();
+		return -2;
+	}
 
 	// ---------------------------------------------------------------
 
@@ -111,13 +119,15 @@ int main()
 
 	// Update loop
 
-	while (glfwWindowShouldClose(window) == 0) {
+	while (benchmark.Running(window)) {
 		// check event queue
+		benchmark.Phase("Events");
 		glfwPollEvents();
 
 		/* your update code here */
-		GLfloat timeval = GLfloat(glfwGetTime());
+		GLfloat timeval = GLfloat(benchmark.Time());
 
+		benchmark.Phase("Draw");
 		// draw background
 		GLfloat red = 0.2f;
 		GLfloat green = 0.3f;
@@ -136,7 +146,7 @@ int main()
 		glBindVertexArray(0);
 
 		// swap buffer
-		glfwSwapBuffers(window);
+		benchmark.SwapBuffers(window);
 	}
 
 	// properly de-allocate all resources
@@ -144,6 +154,7 @@ int main()
 	glDeleteBuffers(1, &VBO);
 	glDeleteProgram(shaderProgram);
 
+	benchmark.Report();
 	glfwTerminate();
 	return 0;
 }
@@ -7,6 +7,7 @@
 #include <GLFW/glfw3.h>
 
 #include "shader.hpp"
+#include "benchmark.hpp"
 
 using namespace cg;
 
@@ -26,12 +27,15 @@ constexpr GLfloat vertices[] = {
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 
-int main()
+int main(int argc, char* argv[])
 {
+	// headless run of a fixed number of frames with --benchmark
+	Benchmark benchmark(argc, argv, "gl_3_3");
+
 	// Setup a GLFW window
 
 	// init GLFW, set GL version & pipeline info
-	glfwInit();
+	benchmark.Init();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -61,6 +65,10 @@ int main()
 		glfwTerminate();
 		return -2;
 	}
+	if (!benchmark.Attach(window)) {
+		glfwTerminate();
+		return -2;
+	}
 
 	// ---------------------------------------------------------------
 
@@ -108,12 +116,14 @@ int main()
 
 	// Update loop
 
-	while (glfwWindowShouldClose(window) == 0) {
+	while (benchmark.Running(window)) {
 		// check event queue
+		benchmark.Phase("Events");
 		glfwPollEvents();
 
 		/* your update code here */
 	
+		benchmark.Phase("Draw");
 		// draw background
 		GLfloat red = 0.2f;
 		GLfloat green = 0.3f;
@@ -128,13 +138,14 @@ int main()
 		glBindVertexArray(0);
 
 		// swap buffer
-		glfwSwapBuffers(window);
+		benchmark.SwapBuffers(window);
 	}
 
 	// properly de-allocate all resources
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
 
+	benchmark.Report();
 	glfwTerminate();
 	return 0;
 }
@@ -8,6 +8,8 @@
 
 #include <glad/glad.h>
 
+#include "programcache.hpp"
+
 namespace cg
 {
 
@@ -34,15 +36,26 @@ public:
 	{
 		// Build and compile our shader programs
 
+		// a program built from the same sources before is loaded from the cache
+		std::string vertexSource, fragmentSource;
+		if (!readSource(vertexFilename, vertexSource) || !readSource(fragmentFilename, fragmentSource)) {
+			return nullptr;
+		}
+		const uint64_t cacheKey = ProgramCache::Key({ "vertex", vertexSource, "fragment", fragmentSource });
+		GLuint program = ProgramCache::Load(cacheKey);
+		if (program != 0) {
+			return std::unique_ptr<Shader>(new Shader(program));
+		}
+
 		// Vertex shaders
-		const GLuint vertexShader = compileShader(vertexFilename, GL_VERTEX_SHADER);
+		const GLuint vertexShader = compileShader(vertexFilename, vertexSource, GL_VERTEX_SHADER);
 		if (vertexShader == 0) {
 			std::cerr << "Cannot create Vertex Shader from file '" << vertexFilename << "'." << std::endl;
 			return nullptr;
 		}
 
 		// Fragment shaders
-		const GLuint fragmentShader = compileShader(fragmentFilename, GL_FRAGMENT_SHADER);
+		const GLuint fragmentShader = compileShader(fragmentFilename, fragmentSource, GL_FRAGMENT_SHADER);
 		if (fragmentShader == 0) {
 			std::cerr << "Cannot create Fragment Shader from file '" << fragmentFilename << "'." << std::endl;
 			glDeleteShader(vertexShader);
@@ -50,9 +63,10 @@ public:
 		}
 
 		// link shaders: including vertex & fragment shaders
-		const GLuint program = glCreateProgram();
+		program = glCreateProgram();
 		glAttachShader(program, vertexShader);
 		glAttachShader(program, fragmentShader);
+		ProgramCache::Prepare(program);
 		glLinkProgram(program);
 
 		// release input shaders
@@ -70,6 +84,7 @@ public:
 			glDeleteProgram(program);
 			return nullptr;
 		}
+		ProgramCache::Store(cacheKey, program);
 
 		return std::unique_ptr<Shader>(new Shader(program));
 	}
@@ -86,7 +101,8 @@ public:
 
 private:
 
-	static const GLuint compileShader(const std::string& filename, GLenum type)
+	// Read a whole shader file
+	static bool readSource(const std::string& filename, std::string& source)
 	{
 		std::ifstream fin;
 
@@ -97,7 +113,7 @@ private:
 		}
 		catch (const std::ifstream::failure& e) {
 			std::cerr << "Shader: open file '" << filename << "' error: " << e.what() << std::endl;
-			return 0;
+			return false;
 		}
 
 		// read all content from file
@@ -109,13 +125,18 @@ private:
 		catch (const std::ifstream::failure& e) {
 			std::cerr << "Shader: read file '" << filename << "' error: " << e.what() << std::endl;
 			fin.close();
-			return 0;
+			return false;
 		}
 
 		// finish reading
 		fin.close();
 
-		const std::string source = stream.str();
+		source = stream.str();
+		return true;
+	}
+
+	static const GLuint compileShader(const std::string& filename, const std::string& source, GLenum type)
+	{
 		const GLchar* source_cstr = source.c_str();
 		const GLuint shader = glCreateShader(type);
 		glShaderSource(shader, 1, &source_cstr, NULL);
@@ -0,0 +1,23 @@
+/*
+ * GLSL Vertex Shader code for OpenGL version 4.6
+ * Instanced: the model matrix comes from the instance buffer, one per cube
+ */
+
+#version 460 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in mat4 model; // locations 1 to 4, a column each
+
+// per frame, from cg::CameraBuffer
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+void main()
+{
+    gl_Position = viewProjection * model * vec4(position, 1.0f);
+}
@@ -39,6 +39,8 @@ public:
     // Returns the view matrix calculated using Eular Angles and the LookAt Matrix
     glm::mat4 ViewMatrix() const { return glm::lookAt(this->position, this->position + this->front, this->up); }
 
+    glm::vec3 Position() const { return this->position; }
+
     GLfloat Zoom() const { return this->zoom; }
 
     // Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -2,6 +2,9 @@
  * OpenGL project.
  */
 #include <iostream>
+#include <random>
+#include <string>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -12,6 +15,8 @@
 
 #include "shader.hpp"
 #include "camera.hpp"
+#include "camerabuffer.hpp"
+#include "benchmark.hpp"
 
 using namespace cg;
 
@@ -78,12 +83,16 @@ constexpr glm::vec3 cubePositions[] = {
 	glm::vec3(-1.3f,  1.0f, -1.5f)
 };
 
+// cubes drawn with --stress
+constexpr int STRESS_CUBE_NUM = 100000;
+
 // callbacks
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void moveCamera();
+std::vector<glm::mat4> cubeModels(int cubeNum);
 
 // Camera
 Camera camera(glm::vec3(0.0f, 0.0f, 7.0f));
@@ -95,12 +104,28 @@ GLfloat deltaTime = 0.0f;    // Time between current frame and last frame
 GLfloat lastFrame = 0.0f;    // Time of last frame
 
 
-int main()
+int main(int argc, char* argv[])
 {
+	int cubeNum = 10;
+	bool perCube = false;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+		if (arg == "--stress") {
+			// draw call stress test: the 10 cubes among many more
+			cubeNum = STRESS_CUBE_NUM;
+		} else if (arg == "--per-cube") {
+			// a uniform & a draw call per cube instead of one instanced draw, to compare
+			perCube = true;
+		}
+	}
+
+	// headless run of a fixed number of frames with --benchmark
+	Benchmark benchmark(argc, argv, "gl_5");
+
 	// Setup a GLFW window
 
 	// init GLFW, set GL version & pipeline info
-	glfwInit();
+	benchmark.Init();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -134,14 +159,21 @@ int main()
 		glfwTerminate();
 		return -2;
 	}
+	if (!benchmark.Attach(window)) {
+		glfwTerminate();
+		return -2;
+	}
 
 	// Setup OpenGL options
 	glEnable(GL_DEPTH_TEST);
 
 	// ---------------------------------------------------------------
 
+	// Per-frame camera matrices, shared by the programs through the Camera uniform block
+	CameraBuffer cameraBuffer;
+
 	// Install GLSL Shader programs
-	auto shaderProgram = Shader::Create("VertexShader.vert", "FragmentShader.frag");
+	auto shaderProgram = Shader::Create(perCube ? "VertexShader.vert" : "InstancedVertexShader.vert", "FragmentShader.frag");
 	if (shaderProgram == nullptr) {
 		std::cerr << "Error creating Shader Program" << std::endl;
 		glfwTerminate();
@@ -168,10 +200,27 @@ int main()
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(0);
 
+	// bind instance VBO, buffer the model matrices of all cubes to it
+	const std::vector<glm::mat4> models = cubeModels(cubeNum);
+	GLuint instanceVBO;
+	glGenBuffers(1, &instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, models.size() * sizeof(glm::mat4), models.data(), GL_STATIC_DRAW);
+
+	// model matrix attribute, a column per location, advancing once per instance
+	for (GLuint column = 0; column < 4; ++column) {
+		glVertexAttribPointer(1 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(column * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(1 + column);
+		glVertexAttribDivisor(1 + column, 1);
+	}
+
 	// unbind VBO & VAO
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 
+	// Look the model matrix up once, for --per-cube
+	const Shader::Uniform modelUniform = shaderProgram->Find("model");
+
 	// ---------------------------------------------------------------
 
 	// Define the viewport dimensions
@@ -179,9 +228,11 @@ int main()
 
 	// Update loop
 
-	while (glfwWindowShouldClose(window) == 0) {
+	while (benchmark.Running(window)) {
+		benchmark.Phase("Events");
+
 		// Calculate deltatime of current frame
-		GLfloat currentFrame = glfwGetTime();
+		GLfloat currentFrame = benchmark.Time();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
@@ -189,8 +240,10 @@ int main()
 		glfwPollEvents();
 
 		/* your update code here */
+		benchmark.Phase("Update");
 		moveCamera();
 
+		benchmark.Phase("Draw");
 		// draw background
 		GLfloat red = 0.2f;
 		GLfloat green = 0.3f;
@@ -201,40 +254,33 @@ int main()
 		// draw a triangle
 		shaderProgram->Use();
 
-		// Camera/View transformation
-		glm::mat4 view = camera.ViewMatrix();
 		// Projection
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom()), (GLfloat)SCR_WIDTH / (GLfloat)SCR_HEIGHT, 0.1f, 100.0f);
-		// Get the uniform locations
-		GLint modelLoc = glGetUniformLocation(shaderProgram->Program(), "model");
-		GLint viewLoc = glGetUniformLocation(shaderProgram->Program(), "view");
-		GLint projLoc = glGetUniformLocation(shaderProgram->Program(), "projection");
-		// Pass the matrices to the shader
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
+		// Camera/View transformation & projection, once for all programs
+		cameraBuffer.Update(camera, projection);
 		glBindVertexArray(VAO);
-		for (GLuint i = 0; i < 10; i++)// draw 10 cubes, each at a different location
-		{
-			// Calculate the model matrix for each object and pass it to shader before drawing
-			glm::mat4 model(1);
-			model = glm::translate(model, cubePositions[i]);
-			GLfloat angle = 20.0f * i;
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		if (perCube) {
+			for (const glm::mat4& model : models) {
+				// pass the model matrix of each cube to the shader before drawing it
+				shaderProgram->Set(modelUniform, model);
+				glDrawArrays(GL_TRIANGLES, 0, 36);
+			}
+		} else {
+			// draw all cubes at once, each instance at a different location
+			glDrawArraysInstanced(GL_TRIANGLES, 0, 36, GLsizei(models.size()));
 		}
 		glBindVertexArray(0);
 
 		// swap buffer
-		glfwSwapBuffers(window);
+		benchmark.SwapBuffers(window);
 	}
 
 	// properly de-allocate all resources
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &instanceVBO);
 
+	benchmark.Report();
 	glfwTerminate();
 	return 0;
 }
@@ -279,6 +325,36 @@ void moveCamera()
 	}
 }
 
+// The model matrices of cubeNum cubes: cubePositions first, then cubes scattered in front of the camera
+std::vector<glm::mat4> cubeModels(int cubeNum)
+{
+	// fixed seed, every run draws the same cubes
+	std::mt19937 random(5489u);
+	std::uniform_real_distribution<GLfloat> x(-40.0f, 40.0f);
+	std::uniform_real_distribution<GLfloat> y(-30.0f, 30.0f);
+	std::uniform_real_distribution<GLfloat> z(-90.0f, -5.0f);
+	std::uniform_real_distribution<GLfloat> degrees(0.0f, 360.0f);
+
+	std::vector<glm::mat4> models;
+	models.reserve(cubeNum);
+	for (int i = 0; i < cubeNum; ++i) {
+		glm::vec3 position;
+		GLfloat angle;
+		if (i < int(sizeof(cubePositions) / sizeof(cubePositions[0]))) {
+			position = cubePositions[i];
+			angle = 20.0f * i;
+		} else {
+			position = glm::vec3(x(random), y(random), z(random));
+			angle = degrees(random);
+		}
+		glm::mat4 model(1);
+		model = glm::translate(model, position);
+		model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+		models.push_back(model);
+	}
+	return models;
+}
+
 void mouseCallback(GLFWwindow* window, double xpos, double ypos)
 {
 	static GLfloat lastX = xpos;
@@ -0,0 +1,121 @@
+#ifndef CG_DISTANCEFIELD_H_
+#define CG_DISTANCEFIELD_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cg
+{
+
+/* Signed distance field of a coverage bitmap.
+ * A texel stores its distance to the outline of the shape, positive inside, mapped so
+ * that 0.5 lies on the outline and 0 / 1 at spread texels outside / inside. Sampled with
+ * linear filtering and thresholded at 0.5, one field stays sharp at any magnification.
+ * Distances are exact Euclidean distances between texel centers (Felzenszwalb &
+ * Huttenlocher's separable transform), the outline lies half a texel from them.
+ */
+class DistanceField
+{
+	static constexpr double FAR = 1e20;
+
+public:
+	/* The field of a width x height bitmap (one coverage byte per texel, rows pitch
+	 * bytes apart) surrounded by spread empty texels on every side.
+	 * field: (width + 2 * spread) x (height + 2 * spread) bytes, rows packed
+	 */
+	static void Generate(const unsigned char* bitmap, int width, int height, int pitch, int spread, unsigned char* field)
+	{
+		const int fieldWidth = width + 2 * spread;
+		const int fieldHeight = height + 2 * spread;
+		const size_t size = size_t(fieldWidth) * fieldHeight;
+
+		// squared distance of every texel to the nearest inside (toInside) and outside (toOutside) texel
+		std::vector<double> toInside(size, FAR);
+		std::vector<double> toOutside(size, 0.0);
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				if (bitmap[size_t(y) * pitch + x] >= 128) {
+					const size_t i = size_t(y + spread) * fieldWidth + x + spread;
+					toInside[i] = 0.0;
+					toOutside[i] = FAR;
+				}
+			}
+		}
+		Transform(toInside.data(), fieldWidth, fieldHeight);
+		Transform(toOutside.data(), fieldWidth, fieldHeight);
+
+		for (size_t i = 0; i < size; ++i) {
+			const double distance = toOutside[i] > 0.0 ? std::sqrt(toOutside[i]) - 0.5 : 0.5 - std::sqrt(toInside[i]);
+			const double value = 0.5 + distance / (2.0 * spread);
+			field[i] = static_cast<unsigned char>(std::min(std::max(value, 0.0), 1.0) * 255.0 + 0.5);
+		}
+	}
+
+private:
+	// 2D squared distance transform in place: columns first, then rows
+	static void Transform(double* grid, int width, int height)
+	{
+		const int n = std::max(width, height);
+		std::vector<double> f(n), d(n), z(n + 1);
+		std::vector<int> v(n);
+
+		for (int x = 0; x < width; ++x) {
+			for (int y = 0; y < height; ++y) {
+				f[y] = grid[size_t(y) * width + x];
+			}
+			Transform1D(f.data(), height, d.data(), v.data(), z.data());
+			for (int y = 0; y < height; ++y) {
+				grid[size_t(y) * width + x] = d[y];
+			}
+		}
+		for (int y = 0; y < height; ++y) {
+			double* row = grid + size_t(y) * width;
+			std::copy(row, row + width, f.begin());
+			Transform1D(f.data(), width, d.data(), v.data(), z.data());
+			std::copy(d.begin(), d.begin() + width, row);
+		}
+	}
+
+	// abscissa where the parabolas rooted at p and q cross
+	static double Intersection(const double* f, int p, int q)
+	{
+		return ((f[q] + double(q) * q) - (f[p] + double(p) * p)) / (2.0 * (q - p));
+	}
+
+	/* 1D squared distance transform of the sampled function f[0, n): the lower envelope
+	 * of the parabolas rooted at every sample.
+	 * v: roots of the envelope's parabolas, z: boundaries between them (n + 1 entries)
+	 */
+	static void Transform1D(const double* f, int n, double* d, int* v, double* z)
+	{
+		int k = 0;
+		v[0] = 0;
+		z[0] = -FAR;
+		z[1] = FAR;
+		for (int q = 1; q < n; ++q) {
+			// f never exceeds FAR, so s stays above z[0] and k never drops below 0
+			double s = Intersection(f, v[k], q);
+			while (s <= z[k]) {
+				--k;
+				s = Intersection(f, v[k], q);
+			}
+			++k;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = FAR;
+		}
+
+		k = 0;
+		for (int q = 0; q < n; ++q) {
+			while (z[k + 1] < q) {
+				++k;
+			}
+			d[q] = double(q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_DISTANCEFIELD_H_ */
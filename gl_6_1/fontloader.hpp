@@ -0,0 +1,208 @@
+#ifndef CG_FONTLOADER_H_
+#define CG_FONTLOADER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "distancefield.hpp"
+
+namespace cg
+{
+
+/// A rasterized glyph on its way to the atlas
+struct GlyphBitmap
+{
+	char32_t codepoint;
+	int size;    // pixel size it was requested at
+	bool loaded; // false when FreeType failed, the glyph stays empty
+	int width;
+	int rows;
+	glm::ivec2 bearing;
+	GLuint advance;
+	std::vector<unsigned char> pixels; // width x rows coverage, or the distance field
+};
+
+/* Rasterizes glyphs on background threads.
+ * FreeType objects must not be shared between threads, so every thread opens its own
+ * FT_Library & face of the font. Threads take (codepoint, size) requests from a queue and
+ * put the finished bitmaps, distance fields already generated, into another one which the
+ * render thread polls.
+ * sdfSpread > 0 turns the glyphs into signed distance fields of that spread.
+ */
+class FontLoader
+{
+	std::string fontFile;
+	int sdfSpread;
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::deque<std::pair<char32_t, int>> requests; // (codepoint, size)
+	std::deque<GlyphBitmap> finished;
+	bool stopping;
+	std::vector<std::thread> threads;
+
+	FontLoader(const FontLoader&) = delete;
+	FontLoader& operator=(const FontLoader&) = delete;
+
+public:
+	FontLoader(const std::string& fontFile, int sdfSpread, int threadNum) :
+		fontFile(fontFile), sdfSpread(sdfSpread), stopping(false)
+	{
+		for (int i = 0; i < threadNum; ++i) {
+			threads.emplace_back(&FontLoader::ThreadLoop, this);
+		}
+	}
+
+	// Drops the requests not started yet
+	~FontLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeUp.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	int ThreadNum() const { return int(threads.size()); }
+
+	// Queue a glyph for rasterization
+	void Request(char32_t codepoint, int size)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requests.emplace_back(codepoint, size);
+		}
+		wakeUp.notify_one();
+	}
+
+	// Take a finished glyph, false when none is ready
+	bool Poll(GlyphBitmap& glyph)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (finished.empty()) {
+			return false;
+		}
+		glyph = std::move(finished.front());
+		finished.pop_front();
+		return true;
+	}
+
+private:
+	void ThreadLoop()
+	{
+		// this thread's own FreeType, all functions return a value different than 0 on error
+		FT_Library ft = nullptr;
+		FT_Face face = nullptr;
+		if (FT_Init_FreeType(&ft)) {
+			std::cerr << "ERROR: FREETYPE: Could not init FreeType Library" << std::endl;
+			ft = nullptr;
+		} else if (FT_New_Face(ft, fontFile.c_str(), 0, &face)) {
+			std::cerr << "ERROR: FREETYPE: Failed to load font '" << fontFile << "'" << std::endl;
+			face = nullptr;
+		} else {
+			FT_Select_Charmap(face, FT_ENCODING_UNICODE);
+		}
+		int faceSize = 0;
+
+		while (true) {
+			std::pair<char32_t, int> request;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [this] { return stopping || !requests.empty(); });
+				if (stopping) {
+					break;
+				}
+				request = requests.front();
+				requests.pop_front();
+			}
+
+			GlyphBitmap glyph;
+			Rasterize(face, faceSize, request.first, request.second, glyph);
+			if (sdfSpread > 0) {
+				GenerateDistanceField(glyph, sdfSpread);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back(std::move(glyph));
+		}
+
+		if (face != nullptr) {
+			FT_Done_Face(face);
+		}
+		if (ft != nullptr) {
+			FT_Done_FreeType(ft);
+		}
+	}
+
+	static void Rasterize(FT_Face face, int& faceSize, char32_t codepoint, int size, GlyphBitmap& glyph)
+	{
+		glyph.codepoint = codepoint;
+		glyph.size = size;
+		glyph.width = glyph.rows = 0;
+		glyph.bearing = glm::ivec2(0);
+		glyph.advance = 0;
+		glyph.pixels.clear();
+
+		// Set size to load glyphs as
+		if (face != nullptr && size != faceSize) {
+			FT_Set_Pixel_Sizes(face, 0, size);
+			faceSize = size;
+		}
+
+		// Load character glyph
+		glyph.loaded = face != nullptr && FT_Load_Char(face, codepoint, FT_LOAD_RENDER) == 0;
+		if (!glyph.loaded) {
+			std::cout << "Warning: FREETYTPE: Failed to load Glyph U+" << std::hex << uint32_t(codepoint) << std::dec << std::endl;
+			return;
+		}
+		const FT_Bitmap& bitmap = face->glyph->bitmap;
+		glyph.width = bitmap.width;
+		glyph.rows = bitmap.rows;
+		glyph.bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+		glyph.advance = GLuint(face->glyph->advance.x);
+		glyph.pixels.resize(size_t(glyph.width) * glyph.rows);
+		for (int y = 0; y < glyph.rows; ++y) {
+			memcpy(&glyph.pixels[size_t(y) * glyph.width], bitmap.buffer + y * bitmap.pitch, glyph.width);
+		}
+	}
+
+	// Replace the coverage of a glyph by its distance field
+	static void GenerateDistanceField(GlyphBitmap& glyph, int spread)
+	{
+		if (glyph.width == 0 || glyph.rows == 0) {
+			return;
+		}
+		const int width = glyph.width + 2 * spread;
+		const int rows = glyph.rows + 2 * spread;
+		std::vector<unsigned char> field(size_t(width) * rows);
+		DistanceField::Generate(glyph.pixels.data(), glyph.width, glyph.rows, glyph.width, spread, field.data());
+
+		// the field covers spread more texels on every side
+		glyph.pixels.swap(field);
+		glyph.width = width;
+		glyph.rows = rows;
+		glyph.bearing += glm::ivec2(-spread, spread);
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_FONTLOADER_H_ */
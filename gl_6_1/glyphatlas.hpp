@@ -0,0 +1,252 @@
+#ifndef CG_GLYPHATLAS_H_
+#define CG_GLYPHATLAS_H_
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+namespace cg
+{
+
+/* Skyline rectangle packer.
+ * The free space of the bin is described by its skyline, the top edge of the
+ * rectangles packed so far, as a list of horizontal segments from left to right.
+ * A rectangle goes where its top ends lowest (bottom-left rule), on ties onto the
+ * narrowest segment, which keeps the skyline flat and the waste small.
+ */
+class SkylinePacker
+{
+	struct Segment
+	{
+		int x;
+		int y;
+		int width;
+	};
+
+	int width;
+	int height;
+	std::vector<Segment> skyline;
+
+public:
+	SkylinePacker(int width, int height) : width(width), height(height)
+	{
+		Reset();
+	}
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+
+	// Empty the bin
+	void Reset()
+	{
+		skyline.clear();
+		skyline.push_back(Segment{ 0, 0, width });
+	}
+
+	/* Find room for a w x h rectangle and reserve it.
+	 * Returns false when it does not fit anymore.
+	 */
+	bool Pack(int w, int h, int& x, int& y)
+	{
+		int best = -1;
+		int bestTop = INT_MAX;
+		int bestWidth = INT_MAX;
+		for (int i = 0; i < int(skyline.size()); ++i) {
+			int top;
+			if (Fit(i, w, h, top) && (top + h < bestTop || (top + h == bestTop && skyline[i].width < bestWidth))) {
+				best = i;
+				bestTop = top + h;
+				bestWidth = skyline[i].width;
+			}
+		}
+		if (best < 0) {
+			return false;
+		}
+		x = skyline[best].x;
+		y = bestTop - h;
+		Insert(best, Segment{ x, bestTop, w });
+		return true;
+	}
+
+private:
+	// Can a w x h rectangle stand on segments i..., top: its lowest y there
+	bool Fit(int i, int w, int h, int& top) const
+	{
+		const int x = skyline[i].x;
+		if (x + w > width) {
+			return false;
+		}
+		top = 0;
+		for (int left = w; left > 0; ++i) {
+			top = std::max(top, skyline[i].y);
+			if (top + h > height) {
+				return false;
+			}
+			left -= skyline[i].width;
+		}
+		return true;
+	}
+
+	// Put segment at index i, shortening the segments it covers & merging equal heights
+	void Insert(int i, const Segment& segment)
+	{
+		skyline.insert(skyline.begin() + i, segment);
+
+		const int end = segment.x + segment.width;
+		while (i + 1 < int(skyline.size()) && skyline[i + 1].x < end) {
+			Segment& next = skyline[i + 1];
+			const int covered = end - next.x;
+			if (covered < next.width) {
+				next.x += covered;
+				next.width -= covered;
+				break;
+			}
+			skyline.erase(skyline.begin() + i + 1);
+		}
+
+		for (int j = 0; j + 1 < int(skyline.size()); ) {
+			if (skyline[j].y == skyline[j + 1].y) {
+				skyline[j].width += skyline[j + 1].width;
+				skyline.erase(skyline.begin() + j + 1);
+			} else {
+				++j;
+			}
+		}
+	}
+};
+
+/// Where a bitmap was stored in a GlyphAtlas
+struct AtlasRegion
+{
+	int page;        // texture page, -1 for an empty bitmap
+	glm::vec2 uvMin; // texture coordinates of the top-left texel
+	glm::vec2 uvMax; // and the bottom-right one
+};
+
+/* One-channel (GL_R8) texture pages holding many small bitmaps, packed by a SkylinePacker.
+ * Bitmaps are uploaded top row first, so uvMin.y is the top of a bitmap. A new page is
+ * opened when the current ones are full, up to maxPages.
+ * Every bitmap is surrounded by padding empty texels so linear filtering never bleeds
+ * a neighbour in. A GL context must be current while the atlas lives.
+ */
+class GlyphAtlas
+{
+	struct Page
+	{
+		GLuint texture;
+		SkylinePacker packer;
+	};
+
+	int pageSize;
+	int padding;
+	int maxPages;
+	std::vector<Page> pages;
+
+	GlyphAtlas(const GlyphAtlas&) = delete;
+	GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+public:
+	explicit GlyphAtlas(int pageSize = 1024, int padding = 1, int maxPages = 4) :
+		pageSize(pageSize), padding(padding), maxPages(maxPages)
+	{
+	}
+
+	~GlyphAtlas()
+	{
+		for (const Page& page : pages) {
+			glDeleteTextures(1, &page.texture);
+		}
+	}
+
+	int PageSize() const { return pageSize; }
+	int PageNum() const { return int(pages.size()); }
+	GLuint Texture(int page) const { return pages[page].texture; }
+
+	/* Copy a width x height bitmap of one byte per texel into the atlas.
+	 * pitch: bytes from a row to the next one
+	 * Returns false when every page is full.
+	 */
+	bool Add(int width, int height, const unsigned char* pixels, int pitch, AtlasRegion& region)
+	{
+		if (width <= 0 || height <= 0) {
+			region = AtlasRegion{ -1, glm::vec2(0.0f), glm::vec2(0.0f) };
+			return true;
+		}
+
+		// the newest page first, older ones may still have holes
+		int x = 0;
+		int y = 0;
+		int page = int(pages.size()) - 1;
+		for (; page >= 0; --page) {
+			if (pages[page].packer.Pack(width + padding, height + padding, x, y)) {
+				break;
+			}
+		}
+		if (page < 0) {
+			if (int(pages.size()) == maxPages || !AddPage() || !pages.back().packer.Pack(width + padding, height + padding, x, y)) {
+				return false;
+			}
+			page = int(pages.size()) - 1;
+		}
+
+		// the packer starts at (padding, padding), a bitmap is followed by padding texels
+		x += padding;
+		y += padding;
+		glBindTexture(GL_TEXTURE_2D, pages[page].texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch != width ? pitch : 0);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RED, GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		region.page = page;
+		region.uvMin = glm::vec2(x, y) / GLfloat(pageSize);
+		region.uvMax = glm::vec2(x + width, y + height) / GLfloat(pageSize);
+		return true;
+	}
+
+	// Empty a page for new bitmaps, the regions on it become invalid
+	void Clear(int page)
+	{
+		pages[page].packer.Reset();
+		glBindTexture(GL_TEXTURE_2D, pages[page].texture);
+		std::vector<unsigned char> empty(size_t(pageSize) * pageSize, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pageSize, pageSize, GL_RED, GL_UNSIGNED_BYTE, empty.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+private:
+	bool AddPage()
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// cleared, the padding around the bitmaps must stay empty
+		std::vector<unsigned char> empty(size_t(pageSize) * pageSize, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, pageSize, pageSize, 0, GL_RED, GL_UNSIGNED_BYTE, empty.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+		if (texture == 0) {
+			return false;
+		}
+
+		// the first row & column are padding, the packer works in the rest
+		Page page = { texture, SkylinePacker(pageSize - padding, pageSize - padding) };
+		pages.push_back(page);
+		return true;
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_GLYPHATLAS_H_ */
@@ -0,0 +1,383 @@
+#ifndef CG_GLYPHCACHE_H_
+#define CG_GLYPHCACHE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "fontloader.hpp"
+#include "glyphatlas.hpp"
+
+namespace cg
+{
+
+/// Holds all state information relevant to a character as loaded using FreeType
+struct Character
+{
+	int Page;           // Atlas page of the glyph, -1 when it has no pixels
+	glm::vec2 UvMin;    // Atlas coordinates of the glyph's top-left
+	glm::vec2 UvMax;    // and bottom-right corners
+	glm::ivec2 Size;    // Size of glyph
+	glm::ivec2 Bearing;  // Offset from baseline to left/top of glyph
+	GLuint Advance;    // Horizontal offset to advance to next glyph
+};
+
+/* Decode the UTF-8 sequence at it and move it past the sequence.
+ * A malformed sequence decodes to U+FFFD and skips one byte only.
+ */
+inline char32_t NextCodepoint(std::string::const_iterator& it, const std::string::const_iterator& end)
+{
+	const unsigned char lead = static_cast<unsigned char>(*it++);
+	if (lead < 0x80) {
+		return lead;
+	}
+
+	int length;
+	char32_t codepoint;
+	char32_t minimum; // smaller ones are overlong encodings
+	if ((lead & 0xE0) == 0xC0) {
+		length = 2; codepoint = lead & 0x1F; minimum = 0x80;
+	} else if ((lead & 0xF0) == 0xE0) {
+		length = 3; codepoint = lead & 0x0F; minimum = 0x800;
+	} else if ((lead & 0xF8) == 0xF0) {
+		length = 4; codepoint = lead & 0x07; minimum = 0x10000;
+	} else {
+		return 0xFFFD;
+	}
+
+	std::string::const_iterator next = it;
+	for (int i = 1; i < length; ++i, ++next) {
+		if (next == end || (static_cast<unsigned char>(*next) & 0xC0) != 0x80) {
+			return 0xFFFD;
+		}
+		codepoint = (codepoint << 6) | (static_cast<unsigned char>(*next) & 0x3F);
+	}
+	if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+		return 0xFFFD;
+	}
+	it = next;
+	return codepoint;
+}
+
+/* The glyphs of a font face, rasterized into a GlyphAtlas on their first use, for any
+ * Unicode codepoint and pixel size.
+ * A FontLoader rasterizes on background threads: a glyph requested for the first time is
+ * missing for a frame or two, until Upload() packs it into the atlas on the render thread
+ * within a time budget. Nothing waits on FreeType, neither startup nor a frame.
+ * Glyphs are found in an open-addressing hash table keyed by (codepoint, size): a lookup
+ * is a multiplication and a probe or two in one array.
+ * When the atlas is full, the page drawn from least recently is cleared and its glyphs are
+ * forgotten, they are rasterized again when needed. The skyline packer cannot free single
+ * rectangles, so whole pages are evicted. Pages drawn from or packed in the current or the
+ * previous frame are never evicted: the quads of this frame are still staged, and Upload()
+ * runs before the layout, when the pages of the previous frame are about to be drawn again.
+ * A working set larger than the atlas waits for the next frame instead of thrashing.
+ * sdfSpread > 0 stores signed distance fields of that spread instead of coverage.
+ */
+class GlyphCache
+{
+	struct Slot
+	{
+		uint64_t key; // 0 for an empty slot
+		bool pending; // requested from the loader, not in the atlas yet
+		Character glyph;
+	};
+
+	GlyphAtlas& atlas;
+	FT_Library ft;  // the render thread's, for metrics & kerning only
+	FT_Face face;
+	int faceSize;   // pixel size the face is set to
+	std::unique_ptr<FontLoader> loader;
+	std::deque<GlyphBitmap> unstored; // rasterized, no room in the atlas yet
+
+	std::vector<Slot> slots; // power of two size, at most half full
+	int glyphNum;
+	std::vector<unsigned long long> pageUse; // last frame every atlas page was drawn from
+	unsigned long long frame;
+	unsigned long long fullFrame; // last frame no page could be evicted in
+	long long loads;
+	long long evictions;
+
+	GlyphCache(const GlyphCache&) = delete;
+	GlyphCache& operator=(const GlyphCache&) = delete;
+
+	GlyphCache(GlyphAtlas& atlas, FT_Library ft, FT_Face face, FontLoader* loader) :
+		atlas(atlas), ft(ft), face(face), faceSize(0), loader(loader),
+		slots(256), glyphNum(0), frame(1), fullFrame(0), loads(0), evictions(0)
+	{
+	}
+
+public:
+	~GlyphCache()
+	{
+		loader.reset();
+		FT_Done_Face(face);
+		FT_Done_FreeType(ft);
+	}
+
+	/* loaderThreads: rasterizing threads, < 0 for one per hardware thread besides
+	 * the render thread, 4 at most
+	 */
+	static std::unique_ptr<GlyphCache> Create(const std::string& fontFile, GlyphAtlas& atlas, int sdfSpread, int loaderThreads = -1)
+	{
+		// All functions return a value different than 0 whenever an error occurred
+		FT_Library ft;
+		if (FT_Init_FreeType(&ft)) {
+			std::cerr << "ERROR: FREETYPE: Could not init FreeType Library" << std::endl;
+			return nullptr;
+		}
+
+		// Load font as face, glyphs are looked up by Unicode codepoint
+		FT_Face face;
+		if (FT_New_Face(ft, fontFile.c_str(), 0, &face)) {
+			std::cerr << "ERROR: FREETYPE: Failed to load font '" << fontFile << "'" << std::endl;
+			FT_Done_FreeType(ft);
+			return nullptr;
+		}
+		FT_Select_Charmap(face, FT_ENCODING_UNICODE);
+
+		if (loaderThreads < 0) {
+			loaderThreads = std::min(std::max(int(std::thread::hardware_concurrency()) - 1, 1), 4);
+		}
+		FontLoader* loader = new FontLoader(fontFile, sdfSpread, std::max(loaderThreads, 1));
+		return std::unique_ptr<GlyphCache>(new GlyphCache(atlas, ft, face, loader));
+	}
+
+	int GlyphNum() const { return glyphNum; }
+	long long Loads() const { return loads; }
+	long long Evictions() const { return evictions; }
+
+	// Start a frame, the pages drawn from until the one after next cannot be evicted
+	void BeginFrame()
+	{
+		++frame;
+	}
+
+	// Mark an atlas page as drawn from in this frame, for glyphs kept outside the cache
+	void Touch(int page)
+	{
+		if (page >= 0 && page < int(pageUse.size())) {
+			pageUse[page] = frame;
+		}
+	}
+
+	// Distance between two baselines at size pixels
+	GLfloat LineHeight(int size)
+	{
+		SetSize(size);
+		return face->size->metrics.height / 64.0f;
+	}
+
+	// Advance correction between two glyphs at size pixels, in 1/64 pixels
+	int Kerning(char32_t left, char32_t right, int size)
+	{
+		if (!FT_HAS_KERNING(face)) {
+			return 0;
+		}
+		SetSize(size);
+		FT_Vector delta;
+		if (FT_Get_Kerning(face, FT_Get_Char_Index(face, left), FT_Get_Char_Index(face, right), FT_KERNING_DEFAULT, &delta)) {
+			return 0;
+		}
+		return int(delta.x);
+	}
+
+	/* Pen advance of a codepoint at size pixels in 1/64 pixels, from its outline, 0 if it
+	 * cannot be loaded. The same as Character::Advance, for glyphs still being rasterized.
+	 */
+	GLuint Advance(char32_t codepoint, int size)
+	{
+		SetSize(size);
+		if (FT_Load_Char(face, codepoint, FT_LOAD_DEFAULT)) {
+			return 0;
+		}
+		return GLuint(face->glyph->advance.x);
+	}
+
+	// Request the glyphs of the codepoints [first, last] before they are drawn
+	void Preload(char32_t first, char32_t last, int size)
+	{
+		for (char32_t codepoint = first; codepoint <= last; ++codepoint) {
+			if (Find(Key(codepoint, size)).key == 0) {
+				Request(codepoint, size);
+			}
+		}
+	}
+
+	/* The glyph of a codepoint at size pixels.
+	 * The pointer is valid until the next Get(), Preload() or Upload().
+	 * Returns nullptr while the glyph is being rasterized (the first request starts it),
+	 * and while every atlas page is in use by the current or the previous frame.
+	 */
+	const Character* Get(char32_t codepoint, int size)
+	{
+		const Slot& slot = Find(Key(codepoint, size));
+		if (slot.key == 0) {
+			Request(codepoint, size);
+			return nullptr;
+		}
+		if (slot.pending) {
+			return nullptr;
+		}
+		if (slot.glyph.Page >= 0) {
+			pageUse[slot.glyph.Page] = frame;
+		}
+		return &slot.glyph;
+	}
+
+	/* Pack the glyphs rasterized since the last call into the atlas, for budget
+	 * milliseconds at most but one glyph at least. Once per frame, on the render thread.
+	 * Returns the number of glyphs packed.
+	 */
+	int Upload(double budget)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		int uploaded = 0;
+		while (fullFrame != frame) {
+			if (uploaded > 0 && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() > budget) {
+				break;
+			}
+			if (unstored.empty()) {
+				GlyphBitmap glyph;
+				if (!loader->Poll(glyph)) {
+					break;
+				}
+				unstored.push_back(std::move(glyph));
+			}
+			if (!Store(unstored.front())) {
+				break;
+			}
+			unstored.pop_front();
+			++uploaded;
+		}
+		return uploaded;
+	}
+
+private:
+	static uint64_t Key(char32_t codepoint, int size)
+	{
+		// sizes start at 1, no key is 0
+		return (uint64_t(size) << 32) | codepoint;
+	}
+
+	// The slot of key, or the empty slot where it goes
+	Slot& Find(uint64_t key)
+	{
+		const size_t mask = slots.size() - 1;
+		size_t i = size_t((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+		while (slots[i].key != 0 && slots[i].key != key) {
+			i = (i + 1) & mask;
+		}
+		return slots[i];
+	}
+
+	// The slot of a key not in the table yet, growing it first when half full
+	Slot& Insert(uint64_t key)
+	{
+		if (2 * (glyphNum + 1) > int(slots.size())) {
+			Rehash(2 * slots.size(), -1);
+		}
+		Slot& slot = Find(key);
+		slot.key = key;
+		++glyphNum;
+		return slot;
+	}
+
+	// Rebuild the table with capacity slots, without the glyphs of evictedPage if >= 0
+	void Rehash(size_t capacity, int evictedPage)
+	{
+		std::vector<Slot> old(capacity);
+		old.swap(slots);
+		glyphNum = 0;
+		for (const Slot& slot : old) {
+			if (slot.key != 0 && (evictedPage < 0 || slot.pending || slot.glyph.Page != evictedPage)) {
+				Find(slot.key) = slot;
+				++glyphNum;
+			}
+		}
+	}
+
+	// Set size to load glyphs as
+	void SetSize(int size)
+	{
+		if (size != faceSize) {
+			FT_Set_Pixel_Sizes(face, 0, size);
+			faceSize = size;
+		}
+	}
+
+	void Request(char32_t codepoint, int size)
+	{
+		Slot& slot = Insert(Key(codepoint, size));
+		slot.pending = true;
+		slot.glyph.Page = -1;
+		loader->Request(codepoint, size);
+		++loads;
+	}
+
+	// Pack a rasterized glyph into the atlas, false when no page can be evicted for it
+	bool Store(const GlyphBitmap& glyph)
+	{
+		AtlasRegion region = { -1, glm::vec2(0.0f), glm::vec2(0.0f) };
+		if (glyph.loaded && !atlas.Add(glyph.width, glyph.rows, glyph.pixels.data(), glyph.width, region)) {
+			// evict the page drawn from least recently, never one of this frame or the previous
+			int victim = -1;
+			for (int page = 0; page < int(pageUse.size()); ++page) {
+				if (pageUse[page] + 1 < frame && (victim < 0 || pageUse[page] < pageUse[victim])) {
+					victim = page;
+				}
+			}
+			if (victim < 0) {
+				fullFrame = frame;
+				return false;
+			}
+			atlas.Clear(victim);
+			Rehash(slots.size(), victim);
+			++evictions;
+
+			if (!atlas.Add(glyph.width, glyph.rows, glyph.pixels.data(), glyph.width, region)) {
+				std::cerr << "GlyphCache: glyph U+" << std::hex << uint32_t(glyph.codepoint) << std::dec << " is larger than an atlas page" << std::endl;
+				region.page = -1;
+			}
+		}
+		pageUse.resize(atlas.PageNum(), 0);
+		if (region.page >= 0) {
+			// the glyph is drawn soon, keep it at least until the next frame
+			pageUse[region.page] = frame;
+		}
+
+		// Now store character for later use
+		const uint64_t key = Key(glyph.codepoint, glyph.size);
+		Slot* slot = &Find(key);
+		if (slot->key == 0) {
+			slot = &Insert(key);
+		}
+		slot->pending = false;
+		slot->glyph = Character{
+			region.page,
+			region.uvMin,
+			region.uvMax,
+			glm::ivec2(glyph.width, glyph.rows),
+			glyph.bearing,
+			glyph.advance
+		};
+		return true;
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_GLYPHCACHE_H_ */
@@ -1,8 +1,12 @@
 /*
  * OpenGL version 3.3 project.
  */
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
-#include <map>
+#include <string>
+#include <vector>
+#include <cstring>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -17,6 +21,12 @@
 #include FT_FREETYPE_H
 
 #include "shader.hpp"
+#include "glyphatlas.hpp"
+#include "textbatch.hpp"
+#include "textlayout.hpp"
+#include "glyphcache.hpp"
+#include "profiler.hpp"
+#include "benchmark.hpp"
 
 using namespace cg;
 
@@ -26,32 +36,58 @@ const int SCR_HEIGHT = 600;
 
 constexpr auto FONT_FILE = "arial.ttf";
 
-/// Holds all state information relevant to a character as loaded using FreeType
-struct Character
-{
-	GLuint TextureID;   // ID handle of the glyph texture
-	glm::ivec2 Size;    // Size of glyph
-	glm::ivec2 Bearing;  // Offset from baseline to left/top of glyph
-	GLuint Advance;    // Horizontal offset to advance to next glyph
-};
+// texels of a signed distance field glyph from the outline to either end of its range
+constexpr int SDF_SPREAD = 8;
+
+// milliseconds of a frame spent packing newly rasterized glyphs into the atlas
+constexpr double GLYPH_UPLOAD_BUDGET = 1.0;
 
-std::map<GLchar, Character> Characters;
+// pixel size glyphs are rasterized at, text is scaled from it
+constexpr int FONT_SIZE = 48;
 
-bool initFont(std::map<GLchar, Character>& characters, const char* const fontFile);
+void RenderText(TextBatch& batch, GlyphCache& glyphCache, const std::string& text, GLfloat x, GLfloat y, GLfloat scale, glm::vec4 color);
 
-void RenderText(GLuint VAO, GLuint VBO, Shader& shader, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color);
+// glyph quads streamed per frame
+constexpr int MAX_GLYPHS_PER_FRAME = 1 << 16;
 
 
 // callbacks
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 
-int main()
+int main(int argc, char* argv[])
 {
+	std::string traceFile;
+	int labelNum = 0;
+	bool sdfText = false;
+	std::string fontFile = FONT_FILE;
+	std::string userText;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+		if (arg == "--profile" && i + 1 < argc) {
+			// profile every frame, print the statistics & write a Chrome trace when leaving
+			traceFile = argv[++i];
+		} else if (arg == "--labels" && i + 1 < argc) {
+			// dashboard stress test: draw that many small labels every frame
+			labelNum = std::max(0, std::atoi(argv[++i]));
+		} else if (arg == "--sdf") {
+			// signed distance field glyphs, sharp at any scale
+			sdfText = true;
+		} else if (arg == "--font" && i + 1 < argc) {
+			fontFile = argv[++i];
+		} else if (arg == "--text" && i + 1 < argc) {
+			// any UTF-8 text, its glyphs are rasterized when first drawn
+			userText = argv[++i];
+		}
+	}
+
+	// headless run of a fixed number of frames with --benchmark
+	Benchmark benchmark(argc, argv, "gl_6_1");
+
 	// Setup a GLFW window
 
 	// init GLFW, set GL version & pipeline info
-	glfwInit();
+	benchmark.Init();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -81,6 +117,10 @@ int main()
 		glfwTerminate();
 		return -2;
 	}
+	if (!benchmark.Attach(window)) {
+		glfwTerminate();
+		return -2;
+	}
 
 	// Setup OpenGL options
 	glEnable(GL_DEPTH_TEST);
@@ -89,7 +129,7 @@ int main()
 	// ---------------------------------------------------------------
 
 	// Install GLSL Shader programs
-	auto shaderProgram = Shader::Create("text.vert", "text.frag");
+	auto shaderProgram = Shader::Create("text.vert", sdfText ? "text_sdf.frag" : "text.frag");
 	if (shaderProgram == nullptr) {
 		std::cerr << "Error creating Shader Program" << std::endl;
 		glfwTerminate();
@@ -98,49 +138,61 @@ int main()
 
 	// ---------------------------------------------------------------
 
-	if (!initFont(Characters, FONT_FILE)) {
-		std::cerr << "Error creating Shader Program" << std::endl;
+	// glyphs are packed on first use, distance fields are padded by their spread
+	std::unique_ptr<GlyphAtlas> glyphAtlas(new GlyphAtlas(sdfText ? 1024 : 512));
+	auto glyphCache = GlyphCache::Create(fontFile, *glyphAtlas, sdfText ? SDF_SPREAD : 0);
+	if (glyphCache == nullptr) {
+		std::cerr << "Error loading font" << std::endl;
 		glfwTerminate();
 		return -4;
 	}
+	// printable ASCII is rasterized in the background right away, anything else on first use
+	glyphCache->Preload(' ', '~', FONT_SIZE);
 
 	// ---------------------------------------------------------------
 
 
-	// Set up vertex data (and buffer(s)) and attribute pointers
-
-	// bind VAO
-	GLuint VAO;
-	GLuint VBO;
+	// Set up the text batch: the quads of every string of a frame are drawn together,
+	// one draw call per atlas page
+	std::unique_ptr<TextBatch> textBatch(new TextBatch(*glyphAtlas, MAX_GLYPHS_PER_FRAME));
 
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+	// constant strings are laid out once, their quads stay on the GPU
+	std::unique_ptr<TextLayout> sampleText(new TextLayout(*glyphCache, *glyphAtlas, FONT_SIZE));
+	sampleText->Set("This is sample text", 25.0f, 25.0f, 1.0f, glm::vec4(0.5, 0.8f, 0.2f, 1.0f));
+	std::unique_ptr<TextLayout> titleText(new TextLayout(*glyphCache, *glyphAtlas, FONT_SIZE));
+	titleText->Set("Freetype text", 540.0f, 570.0f, 0.5f, glm::vec4(0.3, 0.7f, 0.9f, 1.0f));
+	std::unique_ptr<TextLayout> userTextLayout(new TextLayout(*glyphCache, *glyphAtlas, FONT_SIZE));
+	userTextLayout->Set(userText, 25.0f, 300.0f, 0.75f, glm::vec4(0.9f, 0.9f, 0.9f, 1.0f), SCR_WIDTH - 50.0f);
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// labels are laid out every frame, through the batch
+	std::vector<std::string> labels(labelNum);
+	for (int i = 0; i < labelNum; ++i) {
+		labels[i] = "Label " + std::to_string(i);
+	}
 
 	// ---------------------------------------------------------------
 
 	// Define the viewport dimensions
 	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
+	// CPU & GPU time of the text rendering, only with --profile
+	std::unique_ptr<Profiler> profiler(new Profiler(!traceFile.empty()));
+
 	// Update loop
 	glm::mat4 projection = glm::ortho(0.0f, static_cast<GLfloat>(SCR_WIDTH), 0.0f, static_cast<GLfloat>(SCR_HEIGHT));
 	shaderProgram->Use();
 	glUniformMatrix4fv(glGetUniformLocation(shaderProgram->Program(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-	while (glfwWindowShouldClose(window) == 0) {
+	while (benchmark.Running(window)) {
+		profiler->BeginFrame();
+
 		// check event queue
+		benchmark.Phase("Events");
 		glfwPollEvents();
 
 		/* your update code here */
 	
+		benchmark.Phase("Draw");
 		// draw background
 		GLfloat red = 0.2f;
 		GLfloat green = 0.3f;
@@ -148,18 +200,56 @@ int main()
 		glClearColor(red, green, blue, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// draw a triangle
-		RenderText(VAO, VBO, *shaderProgram, "This is sample text", 25.0f, 25.0f, 1.0f, glm::vec3(0.5, 0.8f, 0.2f));
-		RenderText(VAO, VBO, *shaderProgram, "Freetype text", 540.0f, 570.0f, 0.5f, glm::vec3(0.3, 0.7f, 0.9f));
+		// draw text
+		textBatch->BeginFrame();
+		glyphCache->BeginFrame();
+		{
+			CpuScope cpuScope(*profiler, "Glyph upload");
+			glyphCache->Upload(GLYPH_UPLOAD_BUDGET);
+		}
+		{
+			CpuScope cpuScope(*profiler, "Layout");
+			for (int i = 0; i < labelNum; ++i) {
+				const int column = i % 10;
+				const int row = i / 10 % 48;
+				const glm::vec4 color(0.4f + 0.06f * column, 0.9f - 0.01f * row, 0.6f, 1.0f);
+				RenderText(*textBatch, *glyphCache, labels[i], 5.0f + 80.0f * column, 80.0f + 10.0f * row, 0.2f, color);
+			}
+		}
+		{
+			CpuScope cpuScope(*profiler, "Flush");
+			GpuScope gpuScope(*profiler, "Flush");
+			shaderProgram->Use();
+			sampleText->Draw();
+			titleText->Draw();
+			userTextLayout->Draw();
+			textBatch->EndFrame();
+		}
 
 
 		// swap buffer
-		glfwSwapBuffers(window);
+		benchmark.SwapBuffers(window);
+		profiler->EndFrame();
 	}
 
+	if (profiler->Enabled()) {
+		profiler->Flush();
+		profiler->Print(std::cout);
+		profiler->WriteChromeTrace(traceFile);
+	}
+	benchmark.Report();
+
 	// properly de-allocate all resources
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
+	if (textBatch->Dropped() > 0) {
+		std::cerr << textBatch->Dropped() << " glyphs over the " << MAX_GLYPHS_PER_FRAME << " of a frame were not drawn" << std::endl;
+	}
+	profiler.reset();
+	textBatch.reset();
+	sampleText.reset();
+	titleText.reset();
+	userTextLayout.reset();
+	glyphCache.reset();
+	glyphAtlas.reset();
 
 	glfwTerminate();
 	return 0;
@@ -181,124 +271,29 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 	glViewport(0, 0, width, height);
 }
 
-bool initFont(std::map<GLchar, Character>& characters, const char* const fontFile)
+void RenderText(TextBatch& batch, GlyphCache& glyphCache, const std::string& text, GLfloat x, GLfloat y, GLfloat scale, glm::vec4 color)
 {
-	// FreeType
-	FT_Library ft;
-	// All functions return a value different than 0 whenever an error occurred
-	if (FT_Init_FreeType(&ft)) {
-		std::cout << "ERROR: FREETYPE: Could not init FreeType Library" << std::endl;
-		return false;
-	}
-
-	// Load font as face
-	FT_Face face;
-	if (FT_New_Face(ft, fontFile, 0, &face)) {
-		std::cout << "ERROR: FREETYPE: Failed to load font" << std::endl;
-		FT_Done_FreeType(ft);
-		return false;
-	}
-
-	// Set size to load glyphs as
-	FT_Set_Pixel_Sizes(face, 0, 48);
-
-	// Disable byte-alignment restriction
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	// Load first 128 characters of ASCII set
-	GLuint textures[128];
-	glGenTextures(128, textures);
-	for (GLubyte c = 0; c < 128; c++) {
-		// Load character glyph
-		if (FT_Load_Char(face, c, FT_LOAD_RENDER) != 0)         {
-			std::cout << "Warning: FREETYTPE: Failed to load Glyph" << std::endl;
+	// Iterate through all characters, their quads go to the batch
+	std::string::const_iterator c = text.begin();
+	while (c != text.end()) {
+		const char32_t codepoint = NextCodepoint(c, text.end());
+		const Character* glyph = glyphCache.Get(codepoint, FONT_SIZE);
+		if (glyph == nullptr) {
+			// not in the atlas yet, being rasterized: keep its room so the rest of the line stays put
+			x += (glyphCache.Advance(codepoint, FONT_SIZE) >> 6) * scale;
 			continue;
 		}
-		// Generate texture
-		glBindTexture(GL_TEXTURE_2D, textures[int(c)]);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RED,
-			face->glyph->bitmap.width,
-			face->glyph->bitmap.rows,
-			0,
-			GL_RED,
-			GL_UNSIGNED_BYTE,
-			face->glyph->bitmap.buffer
-		);
-		// Set texture options
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		// Now store character for later use
-		Character character = {
-			textures[int(c)],
-			glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-			glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-			GLuint(face->glyph->advance.x)
-		};
-		characters.insert(std::pair<GLchar, Character>(c, character));
-	}
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	// Destroy FreeType once we're finished
-	FT_Done_Face(face);
-	FT_Done_FreeType(ft);
-	
-	return true;
-}
-
-void RenderText(GLuint VAO, GLuint VBO, Shader& shader, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color)
-{
-	// Activate corresponding render state
-	shader.Use();
-	glUniform3f(glGetUniformLocation(shader.Program(), "textColor"), color.x, color.y, color.z);
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(VAO);
-
-	// Iterate through all characters
-	std::string::const_iterator c;
-	for (c = text.begin(); c != text.end(); c++) {
-		Character ch = Characters[*c];
+		const Character& ch = *glyph;
 
 		GLfloat xpos = x + ch.Bearing.x * scale;
 		GLfloat ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
 
 		GLfloat w = ch.Size.x * scale;
 		GLfloat h = ch.Size.y * scale;
-		// Update VBO for each character
-		GLfloat vertices[6][4] = {
-			{ xpos,     ypos + h,   0.0, 1.0 },
-			{ xpos,     ypos,       0.0, 0.0 },
-			{ xpos + w, ypos,       1.0, 0.0 },
-
-			{ xpos,     ypos + h,   0.0, 1.0 },
-			{ xpos + w, ypos,       1.0, 0.0 },
-			{ xpos + w, ypos + h,   1.0, 1.0 }
-		};
-
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-		// Render glyph texture over quad
-		glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-
-		// Update content of VBO memory
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // Be sure to use glBufferSubData and not glBufferData
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		// Render quad
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-
-		glDisable(GL_BLEND);
-
+		// the top of the quad samples the top of the glyph in the atlas
+		batch.Add(ch.Page, xpos, ypos, xpos + w, ypos + h, ch.UvMin, ch.UvMax, color);
 
 		// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
 		x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
 	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -5,9 +5,11 @@
 #version 330 core
 
 // input vertex attributes
-layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 atlas tex>
+layout (location = 1) in vec4 color;
 
 out vec2 TexCoords;
+out vec4 TextColor;
 
 uniform mat4 projection;
 
@@ -15,5 +17,6 @@ uniform mat4 projection;
 void main()
 {
     gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
-    TexCoords = vec2(vertex.z, 1.0f - vertex.w);
+    TexCoords = vertex.zw;
+    TextColor = color;
 }
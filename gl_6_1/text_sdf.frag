@@ -0,0 +1,22 @@
+/*
+ * GLSL Fragment Shader code for OpenGL version 3.3
+ * Signed distance field glyphs: the atlas stores the distance to the outline, 0.5 on it.
+ */
+
+#version 330 core
+
+in vec2 TexCoords;
+in vec4 TextColor;
+
+out vec4 color;
+
+uniform sampler2D text;
+
+void main()
+{
+	float distance = texture(text, TexCoords).r;
+	// change of the distance over one pixel: the edge stays one pixel wide at any scale
+	float width = max(fwidth(distance), 1e-4);
+	float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    color = vec4(TextColor.rgb, TextColor.a * alpha);
+}
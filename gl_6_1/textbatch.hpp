@@ -0,0 +1,186 @@
+#ifndef CG_TEXTBATCH_H_
+#define CG_TEXTBATCH_H_
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "glyphatlas.hpp"
+#include "uploadring.hpp"
+
+namespace cg
+{
+
+/* Collects the glyph quads of any number of strings and draws them with one call per
+ * atlas page. Quads are staged on the CPU per page while the frame is laid out, Flush()
+ * streams every page into an UploadRing and draws it with a shared index buffer, so a
+ * glyph costs 4 vertices and no GL call.
+ *
+ * Vertex layout: location 0 = <vec2 pos, vec2 atlas tex>, location 1 = normalized RGBA8 color.
+ * At most maxGlyphs quads are drawn per frame, the following ones are dropped and counted.
+ */
+class TextBatch
+{
+public:
+	struct Vertex
+	{
+		GLfloat x, y;
+		GLfloat u, v;
+		GLubyte color[4];
+	};
+
+private:
+	const GlyphAtlas& atlas;
+	int maxGlyphs;
+	int glyphNum;      // quads of the current frame, flushed or not
+	long long dropped; // quads over maxGlyphs
+
+	std::unique_ptr<UploadRing> vertexRing;
+	GLuint VAO;
+	GLuint indexBuffer;
+	std::vector<std::vector<Vertex>> pageVertices; // staged quads per atlas page, keep their capacity
+
+	TextBatch(const TextBatch&) = delete;
+	TextBatch& operator=(const TextBatch&) = delete;
+
+public:
+	TextBatch(const GlyphAtlas& atlas, int maxGlyphs) :
+		atlas(atlas), maxGlyphs(maxGlyphs), glyphNum(0), dropped(0),
+		vertexRing(new UploadRing(GL_ARRAY_BUFFER, sizeof(Vertex) * 4 * GLsizeiptr(maxGlyphs)))
+	{
+		// every quad is two triangles over its own 4 vertices
+		std::unique_ptr<GLuint[]> indices(new GLuint[6 * size_t(maxGlyphs)]);
+		for (GLuint i = 0; i < GLuint(maxGlyphs); ++i) {
+			const GLuint quad[6] = { 4 * i, 4 * i + 1, 4 * i + 2, 4 * i, 4 * i + 2, 4 * i + 3 };
+			memcpy(&indices[6 * i], quad, sizeof(quad));
+		}
+
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+		glGenBuffers(1, &indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 6 * maxGlyphs, indices.get(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	~TextBatch()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &indexBuffer);
+	}
+
+	int MaxGlyphs() const { return maxGlyphs; }
+	int GlyphNum() const { return glyphNum; }
+	long long Dropped() const { return dropped; }
+
+	// Start a frame, waits until the GPU has released the ring region it reuses
+	void BeginFrame()
+	{
+		vertexRing->BeginFrame();
+		glyphNum = 0;
+	}
+
+	// Flush the remaining quads and fence the frame's vertices
+	void EndFrame()
+	{
+		Flush();
+		vertexRing->EndFrame();
+	}
+
+	/* Add the quad of a glyph, in screen coordinates: (x0, y0) bottom-left, (x1, y1) top-right.
+	 * uvMin is the top-left of the glyph in the atlas, uvMax its bottom-right.
+	 */
+	void Add(int page, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, const glm::vec2& uvMin, const glm::vec2& uvMax, const glm::vec4& color)
+	{
+		if (page < 0) {
+			return;
+		}
+		if (glyphNum == maxGlyphs) {
+			++dropped;
+			return;
+		}
+		++glyphNum;
+		if (page >= int(pageVertices.size())) {
+			pageVertices.resize(page + 1);
+		}
+
+		AppendQuad(pageVertices[page], x0, y0, x1, y1, uvMin, uvMax, color);
+	}
+
+	// Append the 4 vertices of a glyph quad to vertices, arguments as Add()
+	static void AppendQuad(std::vector<Vertex>& vertices, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, const glm::vec2& uvMin, const glm::vec2& uvMax, const glm::vec4& color)
+	{
+		const glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + glm::vec4(0.5f); // rounded to bytes
+		Vertex v = { 0.0f, 0.0f, 0.0f, 0.0f, { GLubyte(c.r), GLubyte(c.g), GLubyte(c.b), GLubyte(c.a) } };
+		v.x = x0; v.y = y1; v.u = uvMin.x; v.v = uvMin.y; vertices.push_back(v);
+		v.x = x0; v.y = y0; v.u = uvMin.x; v.v = uvMax.y; vertices.push_back(v);
+		v.x = x1; v.y = y0; v.u = uvMax.x; v.v = uvMax.y; vertices.push_back(v);
+		v.x = x1; v.y = y1; v.u = uvMax.x; v.v = uvMin.y; vertices.push_back(v);
+	}
+
+	/* Draw every staged quad, one call per atlas page, blended over the framebuffer
+	 * without depth test: padded quads of neighbour glyphs overlap.
+	 * The text shader must be in use.
+	 */
+	void Flush()
+	{
+		bool blending = false;
+		bool depthTest = false;
+		for (int page = 0; page < int(pageVertices.size()); ++page) {
+			std::vector<Vertex>& vertices = pageVertices[page];
+			if (vertices.empty()) {
+				continue;
+			}
+			const GLsizeiptr size = sizeof(Vertex) * GLsizeiptr(vertices.size());
+			GLintptr offset;
+			void* mapped = vertexRing->Map(size, offset, sizeof(GLfloat));
+			if (mapped == nullptr) {
+				dropped += vertices.size() / 4;
+				vertices.clear();
+				continue;
+			}
+			memcpy(mapped, vertices.data(), size);
+			vertexRing->Unmap();
+
+			if (!blending) {
+				depthTest = glIsEnabled(GL_DEPTH_TEST) == GL_TRUE;
+				glDisable(GL_DEPTH_TEST);
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glActiveTexture(GL_TEXTURE0);
+				glBindVertexArray(VAO);
+				glBindBuffer(GL_ARRAY_BUFFER, vertexRing->Buffer());
+				blending = true;
+			}
+
+			// the quads start at offset in the ring
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offset);
+			glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLvoid*)(offset + offsetof(Vertex, color)));
+			glBindTexture(GL_TEXTURE_2D, atlas.Texture(page));
+			glDrawElements(GL_TRIANGLES, GLsizei(vertices.size() / 4 * 6), GL_UNSIGNED_INT, 0);
+			vertices.clear();
+		}
+		if (blending) {
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindVertexArray(0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glDisable(GL_BLEND);
+			if (depthTest) {
+				glEnable(GL_DEPTH_TEST);
+			}
+		}
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_TEXTBATCH_H_ */
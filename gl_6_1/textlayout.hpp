@@ -0,0 +1,279 @@
+#ifndef CG_TEXTLAYOUT_H_
+#define CG_TEXTLAYOUT_H_
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "glyphatlas.hpp"
+#include "glyphcache.hpp"
+#include "textbatch.hpp"
+
+namespace cg
+{
+
+/* A string shaped once for many frames.
+ * Advances, kerning, line breaks and the bounding box are computed when the text, its
+ * placement or its style changes, and the glyph quads stay in a static vertex buffer sorted
+ * by atlas page. Drawing costs no CPU work and one draw call per atlas page, usually one.
+ * The layout is redone after the glyph cache evicted an atlas page, the quads may sample it.
+ *
+ * Vertex layout: the one of TextBatch, drawn with the same shader.
+ */
+class TextLayout
+{
+	// quads of one atlas page in the vertex buffer
+	struct Range
+	{
+		int page;
+		GLsizei first;
+		GLsizei count;
+	};
+
+	GlyphCache& glyphCache;
+	const GlyphAtlas& atlas;
+	int fontSize;
+
+	std::string text;
+	GLfloat x, y;     // start of the baseline of the first line
+	GLfloat scale;
+	glm::vec4 color;
+	GLfloat maxWidth; // lines wrap between words beyond it, 0 for no wrapping
+
+	bool dirty;          // laid out with other settings, or with glyphs missing
+	long long evictions; // of the glyph cache when laid out
+	glm::vec4 bounds;    // (x0, y0, x1, y1) of the glyph quads
+	int layoutNum;
+
+	std::vector<Range> ranges;
+	std::vector<std::vector<TextBatch::Vertex>> pageVertices; // keep their capacity
+	GLuint VAO;
+	GLuint VBO;
+	GLuint EBO;
+	int quadCapacity; // of the index buffer
+
+	TextLayout(const TextLayout&) = delete;
+	TextLayout& operator=(const TextLayout&) = delete;
+
+public:
+	TextLayout(GlyphCache& glyphCache, const GlyphAtlas& atlas, int fontSize) :
+		glyphCache(glyphCache), atlas(atlas), fontSize(fontSize),
+		x(0.0f), y(0.0f), scale(1.0f), color(1.0f), maxWidth(0.0f),
+		dirty(false), evictions(glyphCache.Evictions()), bounds(0.0f), layoutNum(0), quadCapacity(0)
+	{
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(TextBatch::Vertex), (GLvoid*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextBatch::Vertex), (GLvoid*)offsetof(TextBatch::Vertex, color));
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	~TextLayout()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+	}
+
+	// Times the text was laid out
+	int LayoutNum() const { return layoutNum; }
+
+	/* Set the text & its style, laid out again on the next Draw() only if anything changed.
+	 * (x, y): start of the first baseline, in screen coordinates
+	 */
+	void Set(const std::string& newText, GLfloat newX, GLfloat newY, GLfloat newScale, const glm::vec4& newColor, GLfloat newMaxWidth = 0.0f)
+	{
+		if (newText == text && newX == x && newY == y && newScale == scale && newColor == color && newMaxWidth == maxWidth) {
+			return;
+		}
+		text = newText;
+		x = newX;
+		y = newY;
+		scale = newScale;
+		color = newColor;
+		maxWidth = newMaxWidth;
+		dirty = true;
+	}
+
+	// Bounding box of the glyphs: (x0, y0) bottom-left, (x1, y1) top-right
+	const glm::vec4& Bounds()
+	{
+		Update();
+		return bounds;
+	}
+
+	/* Draw the text blended over the framebuffer, without depth test.
+	 * The text shader must be in use.
+	 */
+	void Draw()
+	{
+		Update();
+		if (ranges.empty()) {
+			return;
+		}
+
+		const bool depthTest = glIsEnabled(GL_DEPTH_TEST) == GL_TRUE;
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glActiveTexture(GL_TEXTURE0);
+		glBindVertexArray(VAO);
+		for (const Range& range : ranges) {
+			// keep the pages in the atlas
+			glyphCache.Touch(range.page);
+			glBindTexture(GL_TEXTURE_2D, atlas.Texture(range.page));
+			glDrawElements(GL_TRIANGLES, 6 * range.count, GL_UNSIGNED_INT, (GLvoid*)(sizeof(GLuint) * 6 * range.first));
+		}
+		glBindVertexArray(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glDisable(GL_BLEND);
+		if (depthTest) {
+			glEnable(GL_DEPTH_TEST);
+		}
+	}
+
+private:
+	void Update()
+	{
+		if (dirty || evictions != glyphCache.Evictions()) {
+			Layout();
+		}
+	}
+
+	// Pen advance of a codepoint in screen pixels, 0 when it cannot be loaded
+	GLfloat Advance(char32_t codepoint)
+	{
+		const Character* ch = glyphCache.Get(codepoint, fontSize);
+		return ch != nullptr ? (ch->Advance >> 6) * scale : 0.0f;
+	}
+
+	// Width of the word starting at it, up to the next space or line break
+	GLfloat WordWidth(std::string::const_iterator it, char32_t previous)
+	{
+		GLfloat width = 0.0f;
+		while (it != text.end()) {
+			const char32_t codepoint = NextCodepoint(it, text.end());
+			if (codepoint == ' ' || codepoint == '\n') {
+				break;
+			}
+			width += glyphCache.Kerning(previous, codepoint, fontSize) / 64.0f * scale + Advance(codepoint);
+			previous = codepoint;
+		}
+		return width;
+	}
+
+	void Layout()
+	{
+		++layoutNum;
+		dirty = false;
+		evictions = glyphCache.Evictions();
+		for (std::vector<TextBatch::Vertex>& vertices : pageVertices) {
+			vertices.clear();
+		}
+
+		const GLfloat lineHeight = glyphCache.LineHeight(fontSize) * scale;
+		GLfloat penX = x;
+		GLfloat penY = y;
+		glm::vec2 boundsMin(FLT_MAX);
+		glm::vec2 boundsMax(-FLT_MAX);
+		char32_t previous = 0; // on the current line
+
+		std::string::const_iterator c = text.begin();
+		while (c != text.end()) {
+			const std::string::const_iterator start = c;
+			const char32_t codepoint = NextCodepoint(c, text.end());
+			if (codepoint == '\n') {
+				penX = x;
+				penY -= lineHeight;
+				previous = 0;
+				continue;
+			}
+			// wrap before a word that does not fit the line anymore
+			if (maxWidth > 0.0f && codepoint != ' ' && previous == ' ' && penX + WordWidth(start, previous) > x + maxWidth) {
+				penX = x;
+				penY -= lineHeight;
+				previous = 0;
+			}
+			if (previous != 0) {
+				penX += glyphCache.Kerning(previous, codepoint, fontSize) / 64.0f * scale;
+			}
+			previous = codepoint;
+
+			const Character* glyph = glyphCache.Get(codepoint, fontSize);
+			if (glyph == nullptr) {
+				dirty = true; // no room in the atlas this frame, try again
+				continue;
+			}
+			const Character& ch = *glyph;
+
+			if (ch.Page >= 0) {
+				GLfloat xpos = penX + ch.Bearing.x * scale;
+				GLfloat ypos = penY - (ch.Size.y - ch.Bearing.y) * scale;
+				GLfloat w = ch.Size.x * scale;
+				GLfloat h = ch.Size.y * scale;
+				if (ch.Page >= int(pageVertices.size())) {
+					pageVertices.resize(ch.Page + 1);
+				}
+				TextBatch::AppendQuad(pageVertices[ch.Page], xpos, ypos, xpos + w, ypos + h, ch.UvMin, ch.UvMax, color);
+				boundsMin = glm::min(boundsMin, glm::vec2(xpos, ypos));
+				boundsMax = glm::max(boundsMax, glm::vec2(xpos + w, ypos + h));
+			}
+
+			// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
+			penX += (ch.Advance >> 6) * scale;
+		}
+		bounds = boundsMin.x <= boundsMax.x ? glm::vec4(boundsMin, boundsMax) : glm::vec4(x, y, x, y);
+
+		Upload();
+	}
+
+	// Copy the quads into the vertex buffer, page after page
+	void Upload()
+	{
+		ranges.clear();
+		std::vector<TextBatch::Vertex> vertices;
+		for (int page = 0; page < int(pageVertices.size()); ++page) {
+			if (!pageVertices[page].empty()) {
+				ranges.push_back(Range{ page, GLsizei(vertices.size() / 4), GLsizei(pageVertices[page].size() / 4) });
+				vertices.insert(vertices.end(), pageVertices[page].begin(), pageVertices[page].end());
+			}
+		}
+		const int quadNum = int(vertices.size() / 4);
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(TextBatch::Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		if (quadNum > quadCapacity) {
+			// every quad is two triangles over its own 4 vertices
+			quadCapacity = std::max(quadNum, 2 * quadCapacity);
+			std::unique_ptr<GLuint[]> indices(new GLuint[6 * size_t(quadCapacity)]);
+			for (GLuint i = 0; i < GLuint(quadCapacity); ++i) {
+				const GLuint quad[6] = { 4 * i, 4 * i + 1, 4 * i + 2, 4 * i, 4 * i + 2, 4 * i + 3 };
+				memcpy(&indices[6 * i], quad, sizeof(quad));
+			}
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 6 * quadCapacity, indices.get(), GL_STATIC_DRAW);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_TEXTLAYOUT_H_ */
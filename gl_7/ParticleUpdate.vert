@@ -0,0 +1,91 @@
+/*
+ * GLSL Vertex Shader code for OpenGL version 3.3
+ * Particle update pass, outputs are captured by transform feedback
+ * (no rasterization): one vertex is one particle of one firework.
+ */
+
+#version 330 core
+// particle state of the previous frame
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 speed;
+layout (location = 2) in vec4 color;
+layout (location = 3) in float fadeSpeed;
+
+// particle state of this frame
+out vec3 outPosition;
+out vec3 outSpeed;
+out vec4 outColor;
+out float outFadeSpeed;
+
+// two texels per firework:
+//   <launch position.xy, events, exploded>
+//   <color.rgb, explosion seed>
+uniform samplerBuffer fireWorks;
+uniform int massNum;      // particles per firework
+uniform float dt;
+uniform vec3 gravity;
+uniform vec3 initialSpeed;
+
+const int EXPLODE = 1;
+const int REVIVE = 2;
+const float PI = 3.14159265358979;
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// uniform in [0, 1)
+float random(inout uint state)
+{
+    state = hash(state);
+    return float(state >> 8) / 16777216.0;
+}
+
+void main(){
+    int fireWork = gl_VertexID / massNum;
+    int particle = gl_VertexID - fireWork * massNum;
+    vec4 launch = texelFetch(fireWorks, fireWork * 2);
+    vec4 look = texelFetch(fireWorks, fireWork * 2 + 1);
+    int events = int(launch.z);
+    bool exploded = launch.w > 0.5;
+
+    vec3 p = position;
+    vec3 v = speed;
+    vec4 c = color;
+
+    if ((events & EXPLODE) != 0) {
+        // simulate uniform spray: a random direction of length 10,
+        // every particle shows up (before, only the first one is visible)
+        uint state = hash(uint(look.w)) ^ uint(particle);
+        float angle1 = random(state) * 2.0 * PI;
+        float angle2 = random(state) * 2.0 * PI;
+        v = 10.0 * vec3(cos(angle2) * cos(angle1), cos(angle2) * sin(angle1), sin(angle2));
+        c.a = 1.0;
+    }
+
+    // gravity until the explosion, fade out after it
+    if (!exploded) {
+        v += gravity * dt;
+    }
+    p += v * dt;
+    if (exploded) {
+        c.a = max(c.a - fadeSpeed * dt, 0.0);
+    }
+
+    if ((events & REVIVE) != 0) {
+        p = vec3(launch.xy, 0.0);
+        v = initialSpeed;
+        c = vec4(look.rgb, particle == 0 ? 1.0 : 0.0);
+    }
+
+    outPosition = p;
+    outSpeed = v;
+    outColor = c;
+    outFadeSpeed = fadeSpeed;
+}
@@ -5,13 +5,14 @@
 #version 330 core
 // <vec2 position, vec2 texCoords>
 layout (location = 0) in vec4 vertex;
+// per instance: particle position & color
+layout (location = 1) in vec2 offset;
+layout (location = 2) in vec4 color;
 
 out vec2 TexCoords;
 out vec4 ParticleColor;
 
 uniform mat4 projection;
-uniform vec2 offset;
-uniform vec4 color;
 
 void main(){
     float scale = 10.0f;
@@ -19,4 +20,3 @@ void main(){
     ParticleColor = color;
     gl_Position = projection * vec4((vertex.xy * scale) + offset, 0.0, 1.0);
 }
-
@@ -0,0 +1,149 @@
+#ifndef CG_ALLOCATIONCOUNTER_H_
+#define CG_ALLOCATIONCOUNTER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace cg
+{
+
+/* Process-wide count of heap allocations made through operator new, the over-aligned
+ * (C++17) and nothrow forms included.
+ * The counting operators are only compiled where CG_COUNT_ALLOCATIONS is defined
+ * before including this header, which must happen in exactly one translation unit.
+ * Compare Allocations() before and after a frame to check that it did not allocate.
+ */
+class AllocationCounter
+{
+	struct Counters
+	{
+		std::atomic<long long> allocations;
+		std::atomic<long long> bytes;
+	};
+
+	static Counters& Get()
+	{
+		// constant initialized, usable from operator new during static initialization
+		static Counters counters = { { 0 }, { 0 } };
+		return counters;
+	}
+
+public:
+	static long long Allocations() { return Get().allocations.load(std::memory_order_relaxed); }
+	static long long Bytes() { return Get().bytes.load(std::memory_order_relaxed); }
+
+	static void Record(std::size_t size)
+	{
+		Get().allocations.fetch_add(1, std::memory_order_relaxed);
+		Get().bytes.fetch_add((long long)size, std::memory_order_relaxed);
+	}
+
+	static void* Allocate(std::size_t size)
+	{
+		Record(size);
+		void* p = std::malloc(size != 0 ? size : 1);
+		if (p == nullptr) {
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+
+	// size bytes aligned to alignment, a power of two; nullptr when out of memory
+	static void* AllocateAligned(std::size_t size, std::size_t alignment)
+	{
+		Record(size);
+		size = size != 0 ? size : 1;
+#ifdef _MSC_VER
+		return _aligned_malloc(size, alignment);
+#else
+		void* p = nullptr;
+		return posix_memalign(&p, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) == 0 ? p : nullptr;
+#endif
+	}
+
+	// Free memory from AllocateAligned()
+	static void FreeAligned(void* p)
+	{
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+};
+
+} /* namespace cg */
+
+#ifdef CG_COUNT_ALLOCATIONS
+
+void* operator new(std::size_t size) { return cg::AllocationCounter::Allocate(size); }
+void* operator new[](std::size_t size) { return cg::AllocationCounter::Allocate(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	cg::AllocationCounter::Record(size);
+	return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	cg::AllocationCounter::Record(size);
+	return std::malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#ifdef __cpp_aligned_new
+// types aligned beyond the default, such as alignas(32) SIMD arrays
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	void* p = cg::AllocationCounter::AllocateAligned(size, std::size_t(alignment));
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	void* p = cg::AllocationCounter::AllocateAligned(size, std::size_t(alignment));
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return cg::AllocationCounter::AllocateAligned(size, std::size_t(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return cg::AllocationCounter::AllocateAligned(size, std::size_t(alignment));
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { cg::AllocationCounter::FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { cg::AllocationCounter::FreeAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { cg::AllocationCounter::FreeAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { cg::AllocationCounter::FreeAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { cg::AllocationCounter::FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { cg::AllocationCounter::FreeAligned(p); }
+
+#endif /* __cpp_aligned_new */
+
+#endif /* CG_COUNT_ALLOCATIONS */
+
+#endif /* CG_ALLOCATIONCOUNTER_H_ */
@@ -0,0 +1,134 @@
+#ifndef CG_ARENA_H_
+#define CG_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cg
+{
+
+/* Bump allocator over one contiguous block.
+ * Allocate() only moves a pointer forward, nothing is freed one by one: the whole
+ * block goes away at once with the arena (or is reused after Reset()). A particle
+ * system, or a whole scene of them, is carved out of a single allocation.
+ *
+ * Objects built with New() are destroyed in reverse order by Reset() and by the
+ * arena's destructor, their destructor records live in the arena as well.
+ */
+class Arena
+{
+	// destructor of an object built with New(), chained newest first
+	struct Destructor
+	{
+		void (*destroy)(void* object);
+		void* object;
+		Destructor* next;
+	};
+
+	std::unique_ptr<char[]> block;
+	std::size_t capacity;
+	std::size_t head; // next free byte
+	std::size_t highWater;
+	Destructor* destructors;
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+public:
+	explicit Arena(std::size_t capacity) :
+		block(new char[capacity]), capacity(capacity), head(0), highWater(0), destructors(nullptr)
+	{
+	}
+
+	~Arena() { Reset(); }
+
+	std::size_t Capacity() const { return capacity; }
+	std::size_t Used() const { return head; }
+	// Most bytes in use at once since construction, Reset() does not lower it
+	std::size_t HighWater() const { return highWater; }
+
+	// Bytes an allocation may take from an arena, alignment padding included
+	static std::size_t Footprint(std::size_t size, std::size_t alignment) { return size + alignment - 1; }
+
+	template <typename T>
+	static std::size_t Footprint(std::size_t num = 1) { return Footprint(num * sizeof(T), alignof(T)); }
+
+	// Footprint of New<T>(), destructor record included
+	template <typename T>
+	static std::size_t NewFootprint()
+	{
+		return Footprint<T>() + (std::is_trivially_destructible<T>::value ? 0 : Footprint<Destructor>());
+	}
+
+	/* size bytes aligned to alignment (a power of two).
+	 * Returns nullptr when the arena is full.
+	 */
+	void* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+	{
+		const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.get());
+		const std::uintptr_t start = (base + head + alignment - 1) & ~std::uintptr_t(alignment - 1);
+		const std::size_t end = std::size_t(start - base) + size;
+		if (end > capacity) {
+			std::cerr << "Arena: out of memory, " << size << " bytes requested, "
+					  << capacity - head << " of " << capacity << " left" << std::endl;
+			return nullptr;
+		}
+		head = end;
+		if (head > highWater) {
+			highWater = head;
+		}
+		return reinterpret_cast<void*>(start);
+	}
+
+	// Uninitialized array of num T
+	template <typename T>
+	T* Allocate(std::size_t num)
+	{
+		return static_cast<T*>(Allocate(num * sizeof(T), alignof(T)));
+	}
+
+	// Construct a T in the arena, nullptr when the arena is full
+	template <typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		Destructor* record = nullptr;
+		if (!std::is_trivially_destructible<T>::value) {
+			record = Allocate<Destructor>(1);
+			if (record == nullptr) {
+				return nullptr;
+			}
+		}
+		void* memory = Allocate(sizeof(T), alignof(T));
+		if (memory == nullptr) {
+			return nullptr;
+		}
+		T* object = new (memory) T(std::forward<Args>(args)...);
+		if (record != nullptr) {
+			record->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+			record->object = object;
+			record->next = destructors;
+			destructors = record;
+		}
+		return object;
+	}
+
+	// Destroy every object built with New() and make the whole block free again
+	void Reset()
+	{
+		while (destructors != nullptr) {
+			Destructor* record = destructors;
+			destructors = record->next;
+			record->destroy(record->object);
+		}
+		head = 0;
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_ARENA_H_ */
@@ -0,0 +1,422 @@
+#ifndef CG_BENCHMARK_H_
+#define CG_BENCHMARK_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+namespace cg
+{
+
+/* Headless benchmark mode of a scene, enabled with --benchmark <frames>.
+ * The scene renders offscreen into a framebuffer object without vsync: on GLFW's null
+ * platform with an EGL (or OSMesa) context where GLFW >= 3.4, so no display or GPU is
+ * needed (llvmpipe works), in a hidden window otherwise. Its clock advances by a fixed
+ * timestep per frame, so every run simulates the same frames.
+ * After the last frame a JSON report of the frame times, the draw calls and the CPU
+ * time of every phase marked by the scene is written.
+ *
+ *   --benchmark <frames>   frames measured
+ *   --warmup <frames>      frames run before measuring, 10 by default
+ *   --timestep <seconds>   simulated time of a frame, 1/60 by default
+ *   --report <file>        JSON report, benchmark_<scene>.json by default, - for stdout
+ *   --osmesa               OSMesa context instead of EGL
+ *
+ * When not benchmarking every call forwards to GLFW, the scene runs as usual.
+ * All memory is allocated up front, a benchmarked frame never allocates.
+ */
+class Benchmark
+{
+public:
+	static constexpr int MAX_PHASES = 16;
+
+private:
+	typedef std::chrono::steady_clock SteadyClock;
+
+	// GL entry points replaced by the draw call counters
+	struct DrawFunctions
+	{
+		PFNGLDRAWARRAYSPROC drawArrays;
+		PFNGLDRAWELEMENTSPROC drawElements;
+		PFNGLDRAWRANGEELEMENTSPROC drawRangeElements;
+		PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced;
+		PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced;
+		PFNGLMULTIDRAWARRAYSPROC multiDrawArrays;
+		PFNGLMULTIDRAWELEMENTSPROC multiDrawElements;
+		long long calls; // since the start of the program
+	};
+
+	std::string scene;
+	int frames;      // measured frames, 0 when not benchmarking
+	int warmUpFrames;
+	double timestep;
+	std::string reportFile;
+	bool osMesa;
+
+	int frame; // frames finished, warm-up included
+	int width;
+	int height;
+	GLuint framebuffer;
+	GLuint renderbuffers[2]; // color, depth & stencil
+
+	// one entry per measured frame, times in milliseconds
+	std::vector<double> frameTimes;
+	std::vector<double> frameDrawCalls;
+	std::vector<double> phaseTimes; // frames x MAX_PHASES
+
+	const char* phaseNames[MAX_PHASES];
+	int phaseNum;
+	int phase; // open phase, -1 if none
+	SteadyClock::time_point frameStart;
+	SteadyClock::time_point phaseStart;
+	long long frameStartCalls;
+
+	Benchmark(const Benchmark&) = delete;
+	Benchmark& operator=(const Benchmark&) = delete;
+
+public:
+	/* Reads the options from the command line, the others are left to the scene.
+	 * scene: name of the report
+	 */
+	Benchmark(int argc, char* argv[], const std::string& scene) :
+		scene(scene), frames(0), warmUpFrames(10), timestep(1.0 / 60.0), reportFile("benchmark_" + scene + ".json"),
+		osMesa(false), frame(0), width(0), height(0), framebuffer(0), phaseNum(0), phase(-1), frameStartCalls(0)
+	{
+		renderbuffers[0] = renderbuffers[1] = 0;
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg(argv[i]);
+			if (arg == "--benchmark" && i + 1 < argc) {
+				frames = std::max(0, std::atoi(argv[++i]));
+			} else if (arg == "--warmup" && i + 1 < argc) {
+				warmUpFrames = std::max(0, std::atoi(argv[++i]));
+			} else if (arg == "--timestep" && i + 1 < argc) {
+				timestep = std::atof(argv[++i]);
+			} else if (arg == "--report" && i + 1 < argc) {
+				reportFile = argv[++i];
+			} else if (arg == "--osmesa") {
+				osMesa = true;
+			}
+		}
+		frameTimes.resize(frames);
+		frameDrawCalls.resize(frames);
+		phaseTimes.resize(size_t(frames) * MAX_PHASES);
+	}
+
+	bool Enabled() const { return frames > 0; }
+
+	/* glfwInit(), on the headless platform when benchmarking.
+	 * Window hints given afterwards are kept.
+	 */
+	int Init()
+	{
+#ifdef GLFW_PLATFORM_NULL
+		if (Enabled()) {
+			glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		}
+#endif
+		const int result = glfwInit();
+		if (result != 0 && Enabled()) {
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_PLATFORM_NULL
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, osMesa ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+#endif
+		}
+		return result;
+	}
+
+	/* Offscreen target, swap interval 0 & draw call counting.
+	 * Call once the context of window is current and GLAD is loaded.
+	 */
+	bool Attach(GLFWwindow* window)
+	{
+		if (!Enabled()) {
+			return true;
+		}
+		glfwSwapInterval(0);
+		glfwGetFramebufferSize(window, &width, &height);
+
+		// a surfaceless context has no default framebuffer, the scene draws in this one
+		// (released with the context by glfwTerminate())
+		glGenRenderbuffers(2, renderbuffers);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "Benchmark: incomplete offscreen framebuffer" << std::endl;
+			return false;
+		}
+		glViewport(0, 0, width, height);
+
+		HookDrawCalls();
+		frameStart = SteadyClock::now();
+		frameStartCalls = Draws().calls;
+		return true;
+	}
+
+	// glfwWindowShouldClose(), or the end of the benchmark
+	bool Running(GLFWwindow* window) const
+	{
+		if (Enabled() && frame >= warmUpFrames + frames) {
+			return false;
+		}
+		return glfwWindowShouldClose(window) == 0;
+	}
+
+	// Seconds since the start, a whole number of timesteps when benchmarking
+	double Time() const { return Enabled() ? frame * timestep : glfwGetTime(); }
+
+	// Seconds of the frame: the fixed timestep when benchmarking, measured otherwise
+	double Delta(double measured) const { return Enabled() ? timestep : measured; }
+
+	/* Start the phase name of the frame, ending the previous one.
+	 * name must be a string literal, at most MAX_PHASES different names are timed.
+	 */
+	void Phase(const char* name)
+	{
+		if (!Enabled()) {
+			return;
+		}
+		const SteadyClock::time_point now = SteadyClock::now();
+		EndPhase(now);
+
+		for (phase = 0; phase < phaseNum; ++phase) {
+			if (phaseNames[phase] == name || std::strcmp(phaseNames[phase], name) == 0) {
+				break;
+			}
+		}
+		if (phase == phaseNum) {
+			if (phaseNum == MAX_PHASES) {
+				phase = -1;
+				return;
+			}
+			phaseNames[phaseNum++] = name;
+		}
+		phaseStart = now;
+	}
+
+	/* glfwSwapBuffers(), then ends the frame.
+	 * When benchmarking it waits for the GPU, the frame time includes the rendering.
+	 */
+	void SwapBuffers(GLFWwindow* window)
+	{
+		if (!Enabled()) {
+			glfwSwapBuffers(window);
+			return;
+		}
+		Phase("Swap");
+		glfwSwapBuffers(window);
+		glFinish();
+
+		const SteadyClock::time_point now = SteadyClock::now();
+		EndPhase(now);
+		phase = -1;
+		if (frame >= warmUpFrames) {
+			const int i = frame - warmUpFrames;
+			frameTimes[i] = Milliseconds(frameStart, now);
+			frameDrawCalls[i] = double(Draws().calls - frameStartCalls);
+		}
+		++frame;
+		frameStart = now;
+		frameStartCalls = Draws().calls;
+	}
+
+	/* Write the JSON report, when benchmarking.
+	 * Call before glfwTerminate(), the report names the GL renderer.
+	 */
+	bool Report() const
+	{
+		if (!Enabled()) {
+			return true;
+		}
+		const int measured = std::max(0, std::min(frames, frame - warmUpFrames));
+		if (measured == 0) {
+			std::cerr << "Benchmark: no frame measured" << std::endl;
+			return false;
+		}
+
+		std::ofstream fout;
+		if (reportFile != "-") {
+			fout.open(reportFile);
+			if (!fout) {
+				std::cerr << "Benchmark: cannot write report file '" << reportFile << "'" << std::endl;
+				return false;
+			}
+		}
+		std::ostream& out = reportFile != "-" ? fout : std::cout;
+
+		out << "{\n";
+		out << "  \"scene\": \"" << Escape(scene) << "\",\n";
+		out << "  \"renderer\": \"" << Escape(GlString(GL_RENDERER)) << "\",\n";
+		out << "  \"version\": \"" << Escape(GlString(GL_VERSION)) << "\",\n";
+		out << "  \"width\": " << width << ",\n";
+		out << "  \"height\": " << height << ",\n";
+		out << "  \"frames\": " << measured << ",\n";
+		out << "  \"warmupFrames\": " << warmUpFrames << ",\n";
+		out << "  \"timestep\": " << timestep << ",\n";
+		out << "  \"frameTimeMs\": ";
+		WriteStats(out, frameTimes, measured);
+		out << ",\n  \"drawCalls\": ";
+		WriteStats(out, frameDrawCalls, measured);
+		out << ",\n  \"phaseCpuTimeMs\": {";
+		std::vector<double> times(measured);
+		for (int p = 0; p < phaseNum; ++p) {
+			for (int i = 0; i < measured; ++i) {
+				times[i] = phaseTimes[size_t(i) * MAX_PHASES + p];
+			}
+			out << (p == 0 ? "\n" : ",\n") << "    \"" << Escape(phaseNames[p]) << "\": ";
+			WriteStats(out, times, measured);
+		}
+		out << (phaseNum == 0 ? "}\n" : "\n  }\n") << "}" << std::endl;
+		return bool(out);
+	}
+
+private:
+	static double Milliseconds(SteadyClock::time_point from, SteadyClock::time_point to)
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+	void EndPhase(SteadyClock::time_point now)
+	{
+		if (phase >= 0 && frame >= warmUpFrames) {
+			phaseTimes[size_t(frame - warmUpFrames) * MAX_PHASES + phase] += Milliseconds(phaseStart, now);
+		}
+	}
+
+	// mean, min, max & nearest-rank percentiles of values[0, num)
+	static void WriteStats(std::ostream& out, const std::vector<double>& values, int num)
+	{
+		std::vector<double> sorted(values.begin(), values.begin() + num);
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (double v : sorted) {
+			sum += v;
+		}
+		auto percentile = [&sorted](double p) {
+			const int rank = int(std::ceil(p / 100.0 * sorted.size()));
+			return sorted[std::max(rank, 1) - 1];
+		};
+
+		out << std::fixed << std::setprecision(4)
+			<< "{ \"mean\": " << sum / num << ", \"min\": " << sorted.front()
+			<< ", \"p50\": " << percentile(50) << ", \"p90\": " << percentile(90)
+			<< ", \"p99\": " << percentile(99) << ", \"max\": " << sorted.back()
+			<< ", \"total\": " << sum << " }" << std::defaultfloat;
+	}
+
+	static std::string GlString(GLenum name)
+	{
+		const GLubyte* s = glGetString(name);
+		return s != nullptr ? reinterpret_cast<const char*>(s) : "";
+	}
+
+	static std::string Escape(const std::string& s)
+	{
+		std::string escaped;
+		for (char c : s) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+				escaped += c;
+			} else if (static_cast<unsigned char>(c) >= 0x20) {
+				escaped += c;
+			}
+		}
+		return escaped;
+	}
+
+	/* ======================== draw call counting ======================== */
+
+	static DrawFunctions& Draws()
+	{
+		static DrawFunctions draws = {};
+		return draws;
+	}
+
+	// Route the GLAD draw entry points through the counters, once per program
+	static void HookDrawCalls()
+	{
+		DrawFunctions& draws = Draws();
+		if (draws.drawArrays != nullptr) {
+			return;
+		}
+		draws.drawArrays = glad_glDrawArrays;
+		draws.drawElements = glad_glDrawElements;
+		draws.drawRangeElements = glad_glDrawRangeElements;
+		draws.drawArraysInstanced = glad_glDrawArraysInstanced;
+		draws.drawElementsInstanced = glad_glDrawElementsInstanced;
+		draws.multiDrawArrays = glad_glMultiDrawArrays;
+		draws.multiDrawElements = glad_glMultiDrawElements;
+
+		glad_glDrawArrays = DrawArrays;
+		glad_glDrawElements = DrawElements;
+		glad_glDrawRangeElements = DrawRangeElements;
+		glad_glDrawArraysInstanced = DrawArraysInstanced;
+		glad_glDrawElementsInstanced = DrawElementsInstanced;
+		glad_glMultiDrawArrays = MultiDrawArrays;
+		glad_glMultiDrawElements = MultiDrawElements;
+	}
+
+	static void APIENTRY DrawArrays(GLenum mode, GLint first, GLsizei count)
+	{
+		++Draws().calls;
+		Draws().drawArrays(mode, first, count);
+	}
+
+	static void APIENTRY DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+	{
+		++Draws().calls;
+		Draws().drawElements(mode, count, type, indices);
+	}
+
+	static void APIENTRY DrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices)
+	{
+		++Draws().calls;
+		Draws().drawRangeElements(mode, start, end, count, type, indices);
+	}
+
+	static void APIENTRY DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount)
+	{
+		++Draws().calls;
+		Draws().drawArraysInstanced(mode, first, count, instanceCount);
+	}
+
+	static void APIENTRY DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount)
+	{
+		++Draws().calls;
+		Draws().drawElementsInstanced(mode, count, type, indices, instanceCount);
+	}
+
+	// a multi-draw is one call
+	static void APIENTRY MultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawCount)
+	{
+		++Draws().calls;
+		Draws().multiDrawArrays(mode, first, count, drawCount);
+	}
+
+	static void APIENTRY MultiDrawElements(GLenum mode, const GLsizei* count, GLenum type, const void* const* indices, GLsizei drawCount)
+	{
+		++Draws().calls;
+		Draws().multiDrawElements(mode, count, type, indices, drawCount);
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_BENCHMARK_H_ */
@@ -0,0 +1,264 @@
+#ifndef CG_GPUFIREWORK_H_
+#define CG_GPUFIREWORK_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shader.hpp"
+#include "random.hpp"
+#include "particlerenderer.hpp"
+
+namespace cg
+{
+
+/* GPU-resident fireworks, same look as FireWork.
+ * Every firework owns a fixed block of particles that is revived in place: the
+ * rocket is its first particle, the others stay invisible until the explosion.
+ * The particles of every firework live in two buffers that are advanced in turn by a
+ * transform feedback pass (ParticleUpdate.vert): gravity, explosion spray, fade and
+ * revive all run on the GPU and the result is drawn straight from the buffer.
+ * The CPU only keeps a few scalars per firework (rocket speed, life, random stream)
+ * to decide when it explodes or revives, and sends these events as two texels per
+ * firework, so no per-particle data crosses the bus after Launch().
+ */
+class GpuFireWorks
+{
+public:
+	// floats per particle: position.xyz, speed.xyz, color.rgba, fadeSpeed
+	static constexpr int PARTICLE_FLOATS = 11;
+
+	// events of a firework in one frame
+	static constexpr int EXPLODE = 1;
+	static constexpr int REVIVE = 2;
+
+private:
+	// CPU side of one firework, the rocket of FireWork without any particle
+	struct Launcher
+	{
+		GLfloat rocketSpeed; // vertical speed of the first particle until the explosion
+		double lifeLeft;
+		double initialLife;
+		bool hasExploded;
+		Random rng;
+	};
+
+	int fireWorkNum;
+	int massNum;
+	glm::vec3 initialSpeed;
+	glm::vec3 gravity;
+
+	std::unique_ptr<Shader> updateProgram;
+	Shader::Uniform dtUniform;
+
+	GLuint stateBuffers[2]; // particles of the last frame & the next one
+	GLuint stateVAOs[2];    // update pass input, reading stateBuffers[i]
+	int current;            // stateBuffers[current] holds the latest particles
+
+	GLuint fireWorkBuffer;  // per firework events, read as a buffer texture
+	GLuint fireWorkTexture;
+	std::vector<GLfloat> fireWorkData;
+	std::vector<Launcher> launchers;
+
+	GpuFireWorks(const GpuFireWorks&) = delete;
+	GpuFireWorks& operator=(const GpuFireWorks&) = delete;
+
+	GpuFireWorks(std::unique_ptr<Shader> program, int fireWorkNum, int massNum, glm::vec3 speed, glm::vec3 gravity) :
+		fireWorkNum(fireWorkNum), massNum(massNum), initialSpeed(speed), gravity(gravity),
+		updateProgram(std::move(program)), current(0), fireWorkData(fireWorkNum * 8, 0.0f)
+	{
+		const GLsizeiptr stateSize = GLsizeiptr(fireWorkNum) * massNum * PARTICLE_FLOATS * sizeof(GLfloat);
+		const GLsizei stride = PARTICLE_FLOATS * sizeof(GLfloat);
+
+		glGenBuffers(2, stateBuffers);
+		glGenVertexArrays(2, stateVAOs);
+		for (int i = 0; i < 2; ++i) {
+			glBindVertexArray(stateVAOs[i]);
+			glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[i]);
+			glBufferData(GL_ARRAY_BUFFER, stateSize, NULL, GL_DYNAMIC_COPY);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(GLfloat)));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(6 * sizeof(GLfloat)));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(10 * sizeof(GLfloat)));
+			glEnableVertexAttribArray(3);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+
+		glGenBuffers(1, &fireWorkBuffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, fireWorkBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, fireWorkData.size() * sizeof(GLfloat), fireWorkData.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		glGenTextures(1, &fireWorkTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, fireWorkTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, fireWorkBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		// constant uniforms
+		updateProgram->Use();
+		updateProgram->Set("fireWorks", 0);
+		updateProgram->Set("massNum", massNum);
+		updateProgram->Set("gravity", gravity);
+		updateProgram->Set("initialSpeed", initialSpeed);
+		dtUniform = updateProgram->Find("dt");
+		glUseProgram(0);
+
+		launchers.reserve(fireWorkNum);
+		for (int i = 0; i < fireWorkNum; ++i) {
+			launchers.push_back(Launcher{ speed.y, 0.0, 0.0, false, Random::Stream(0) });
+		}
+	}
+
+public:
+	/* updateShaderFilename: the transform feedback update pass (ParticleUpdate.vert)
+	 * massNum: particles per firework
+	 * speed: initial speed of every firework
+	 * Returns nullptr when the update pass cannot be built.
+	 */
+	static std::unique_ptr<GpuFireWorks> Create(const std::string& updateShaderFilename, int fireWorkNum, int massNum,
+												glm::vec3 speed, glm::vec3 gravity)
+	{
+		const std::vector<const GLchar*> varyings = { "outPosition", "outSpeed", "outColor", "outFadeSpeed" };
+		auto program = Shader::CreateTransformFeedback(updateShaderFilename, varyings);
+		if (program == nullptr) {
+			std::cerr << "GpuFireWorks: cannot create the update pass" << std::endl;
+			return nullptr;
+		}
+		return std::unique_ptr<GpuFireWorks>(new GpuFireWorks(std::move(program), fireWorkNum, massNum, speed, gravity));
+	}
+
+	~GpuFireWorks()
+	{
+		glDeleteVertexArrays(2, stateVAOs);
+		glDeleteBuffers(2, stateBuffers);
+		glDeleteTextures(1, &fireWorkTexture);
+		glDeleteBuffers(1, &fireWorkBuffer);
+	}
+
+	int FireWorkNum() const { return fireWorkNum; }
+	int GetMassNum() const { return massNum; }
+	bool HasExploded(int i) const { return launchers[i].hasExploded; }
+
+	/* (Re)start firework i at position, living lifeValue seconds per launch.
+	 * stream: id of its random stream, see Random::SetSeed() for reproducible runs.
+	 * Uploads its particles once, call it at setup only.
+	 */
+	void Launch(int i, glm::vec3 position, double lifeValue, std::uint64_t stream)
+	{
+		Launcher& launcher = launchers[i];
+		launcher = Launcher{ initialSpeed.y, lifeValue, lifeValue, false, Random::Stream(stream) };
+
+		// only the first particle is visible until the explosion
+		const glm::vec3 color = RandomColor(launcher.rng);
+		std::vector<GLfloat> state(massNum * PARTICLE_FLOATS);
+		for (int k = 0; k < massNum; ++k) {
+			GLfloat* p = &state[k * PARTICLE_FLOATS];
+			p[0] = position.x;
+			p[1] = position.y;
+			p[2] = position.z;
+			p[3] = initialSpeed.x;
+			p[4] = initialSpeed.y;
+			p[5] = initialSpeed.z;
+			p[6] = color.r;
+			p[7] = color.g;
+			p[8] = color.b;
+			p[9] = k == 0 ? 1.0f : 0.0f;
+			p[10] = GLfloat(launcher.rng.NextFloat() < 0.5f ? 50 / 255. : 40 / 255.);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[current]);
+		glBufferSubData(GL_ARRAY_BUFFER, GLintptr(i) * massNum * PARTICLE_FLOATS * sizeof(GLfloat),
+						state.size() * sizeof(GLfloat), state.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	/* Advance every firework by dt.
+	 * newPositions[i]: launch position of firework i if it revives in this frame
+	 */
+	void Process(double dt, const glm::vec3* newPositions)
+	{
+		// decide the events of every firework, as FireWork::Apply() & Update() do
+		for (int i = 0; i < fireWorkNum; ++i) {
+			Launcher& launcher = launchers[i];
+			GLfloat* texels = &fireWorkData[i * 8];
+			int events = 0;
+
+			if (!launcher.hasExploded && launcher.rocketSpeed < 10) { // time to explode
+				events |= EXPLODE;
+				launcher.hasExploded = true;
+				texels[7] = GLfloat(launcher.rng.Next() >> 8); // spray seed, exact as a float
+			}
+			const bool exploded = launcher.hasExploded;
+			if (!exploded) {
+				launcher.rocketSpeed += gravity.y * GLfloat(dt);
+			}
+
+			launcher.lifeLeft -= dt;
+			if (launcher.lifeLeft < 1e-2) { // revive
+				events |= REVIVE;
+				const glm::vec3 color = RandomColor(launcher.rng);
+				texels[0] = newPositions[i].x;
+				texels[1] = newPositions[i].y;
+				texels[4] = color.r;
+				texels[5] = color.g;
+				texels[6] = color.b;
+				launcher.rocketSpeed = initialSpeed.y;
+				launcher.lifeLeft = launcher.initialLife;
+				launcher.hasExploded = false;
+			}
+			texels[2] = GLfloat(events);
+			texels[3] = exploded ? 1.0f : 0.0f;
+		}
+
+		// orphan & refill the event texels, a few bytes per firework
+		glBindBuffer(GL_TEXTURE_BUFFER, fireWorkBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, fireWorkData.size() * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, fireWorkData.size() * sizeof(GLfloat), fireWorkData.data());
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		// update pass: stateBuffers[current] -> stateBuffers[next], nothing is rasterized
+		const int next = 1 - current;
+		updateProgram->Use();
+		updateProgram->Set(dtUniform, GLfloat(dt));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, fireWorkTexture);
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBindVertexArray(stateVAOs[current]);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, stateBuffers[next]);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, fireWorkNum * massNum);
+		glEndTransformFeedback();
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glBindVertexArray(0);
+		glDisable(GL_RASTERIZER_DISCARD);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		current = next;
+	}
+
+	// Draw every particle from GPU memory, the particle shader program must be in use
+	void Draw(ParticleRenderer& renderer, GLuint texture) const
+	{
+		renderer.DrawBuffer(stateBuffers[current], 0, PARTICLE_FLOATS * sizeof(GLfloat), 6 * sizeof(GLfloat),
+							fireWorkNum * massNum, texture);
+	}
+
+private:
+	static glm::vec3 RandomColor(Random& rng)
+	{
+		const GLfloat r = rng.NextFloat();
+		const GLfloat g = rng.NextFloat();
+		const GLfloat b = rng.NextFloat();
+		return glm::vec3(r, g, b);
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_GPUFIREWORK_H_ */
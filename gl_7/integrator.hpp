@@ -0,0 +1,249 @@
+#ifndef CG_INTEGRATOR_H_
+#define CG_INTEGRATOR_H_
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "particlestore.hpp"
+#include "clock.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CG_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit wider instructions inside functions that ask for them,
+// MSVC accepts any intrinsic anywhere
+#if defined(CG_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CG_TARGET_SSE __attribute__((target("sse2")))
+#define CG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CG_TARGET_SSE
+#define CG_TARGET_AVX2
+#endif
+
+namespace cg
+{
+
+/* Batch particle integrator.
+ * One pass over a ParticleStore range does everything a frame needs per particle:
+ *     speed    += (force / m + gravity) * dt
+ *     position += speed * dt
+ *     force     = 0
+ *     alpha     = max(alpha - fadeSpeed * fadeDt, 0)
+ * The scalar, SSE and AVX2 kernels perform the same operations in the same order
+ * (the vector paths never use FMA), so switching paths does not change the results.
+ */
+struct StepParams
+{
+	GLfloat dt;        // time step
+	GLfloat invMass;   // 1 / mass of every particle in the range
+	glm::vec3 gravity; // acceleration applied on top of the accumulated force
+	GLfloat fadeDt;    // time step of the alpha fade, 0 disables fading
+};
+
+enum class SimdPath
+{
+	SCALAR,
+	SSE,
+	AVX2
+};
+
+typedef void (*IntegrateFunc)(ParticleStore& p, int begin, int end, const StepParams& params);
+
+inline const char* SimdPathName(SimdPath path)
+{
+	switch (path) {
+	case SimdPath::AVX2:
+		return "AVX2";
+	case SimdPath::SSE:
+		return "SSE";
+	default:
+		return "scalar";
+	}
+}
+
+inline void IntegrateScalar(ParticleStore& p, int begin, int end, const StepParams& params)
+{
+	const GLfloat dt = params.dt;
+	const GLfloat invDt = params.invMass * params.dt;
+	const GLfloat gx = params.gravity.x * dt, gy = params.gravity.y * dt, gz = params.gravity.z * dt;
+	const GLfloat fadeDt = params.fadeDt;
+	for (int i = begin; i < end; ++i) {
+		p.speedX[i] = p.speedX[i] + (p.forceX[i] * invDt + gx);
+		p.speedY[i] = p.speedY[i] + (p.forceY[i] * invDt + gy);
+		p.speedZ[i] = p.speedZ[i] + (p.forceZ[i] * invDt + gz);
+		p.positionX[i] = p.positionX[i] + p.speedX[i] * dt;
+		p.positionY[i] = p.positionY[i] + p.speedY[i] * dt;
+		p.positionZ[i] = p.positionZ[i] + p.speedZ[i] * dt;
+		p.forceX[i] = 0.0f;
+		p.forceY[i] = 0.0f;
+		p.forceZ[i] = 0.0f;
+		p.colorA[i] = std::max(p.colorA[i] - p.fadeSpeed[i] * fadeDt, 0.0f);
+	}
+}
+
+#ifdef CG_SIMD_X86
+
+CG_TARGET_SSE inline void IntegrateSSE(ParticleStore& p, int begin, int end, const StepParams& params)
+{
+	const GLfloat invDt = params.invMass * params.dt;
+	const __m128 dt = _mm_set1_ps(params.dt);
+	const __m128 impulse = _mm_set1_ps(invDt);
+	const __m128 gx = _mm_set1_ps(params.gravity.x * params.dt);
+	const __m128 gy = _mm_set1_ps(params.gravity.y * params.dt);
+	const __m128 gz = _mm_set1_ps(params.gravity.z * params.dt);
+	const __m128 fadeDt = _mm_set1_ps(params.fadeDt);
+	const __m128 zero = _mm_setzero_ps();
+
+	int i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 vx = _mm_add_ps(_mm_loadu_ps(p.speedX + i), _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p.forceX + i), impulse), gx));
+		__m128 vy = _mm_add_ps(_mm_loadu_ps(p.speedY + i), _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p.forceY + i), impulse), gy));
+		__m128 vz = _mm_add_ps(_mm_loadu_ps(p.speedZ + i), _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p.forceZ + i), impulse), gz));
+		_mm_storeu_ps(p.speedX + i, vx);
+		_mm_storeu_ps(p.speedY + i, vy);
+		_mm_storeu_ps(p.speedZ + i, vz);
+		_mm_storeu_ps(p.positionX + i, _mm_add_ps(_mm_loadu_ps(p.positionX + i), _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(p.positionY + i, _mm_add_ps(_mm_loadu_ps(p.positionY + i), _mm_mul_ps(vy, dt)));
+		_mm_storeu_ps(p.positionZ + i, _mm_add_ps(_mm_loadu_ps(p.positionZ + i), _mm_mul_ps(vz, dt)));
+		_mm_storeu_ps(p.forceX + i, zero);
+		_mm_storeu_ps(p.forceY + i, zero);
+		_mm_storeu_ps(p.forceZ + i, zero);
+		__m128 alpha = _mm_sub_ps(_mm_loadu_ps(p.colorA + i), _mm_mul_ps(_mm_loadu_ps(p.fadeSpeed + i), fadeDt));
+		_mm_storeu_ps(p.colorA + i, _mm_max_ps(alpha, zero));
+	}
+	IntegrateScalar(p, i, end, params);
+}
+
+CG_TARGET_AVX2 inline void IntegrateAVX2(ParticleStore& p, int begin, int end, const StepParams& params)
+{
+	const GLfloat invDt = params.invMass * params.dt;
+	const __m256 dt = _mm256_set1_ps(params.dt);
+	const __m256 impulse = _mm256_set1_ps(invDt);
+	const __m256 gx = _mm256_set1_ps(params.gravity.x * params.dt);
+	const __m256 gy = _mm256_set1_ps(params.gravity.y * params.dt);
+	const __m256 gz = _mm256_set1_ps(params.gravity.z * params.dt);
+	const __m256 fadeDt = _mm256_set1_ps(params.fadeDt);
+	const __m256 zero = _mm256_setzero_ps();
+
+	int i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 vx = _mm256_add_ps(_mm256_loadu_ps(p.speedX + i), _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(p.forceX + i), impulse), gx));
+		__m256 vy = _mm256_add_ps(_mm256_loadu_ps(p.speedY + i), _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(p.forceY + i), impulse), gy));
+		__m256 vz = _mm256_add_ps(_mm256_loadu_ps(p.speedZ + i), _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(p.forceZ + i), impulse), gz));
+		_mm256_storeu_ps(p.speedX + i, vx);
+		_mm256_storeu_ps(p.speedY + i, vy);
+		_mm256_storeu_ps(p.speedZ + i, vz);
+		_mm256_storeu_ps(p.positionX + i, _mm256_add_ps(_mm256_loadu_ps(p.positionX + i), _mm256_mul_ps(vx, dt)));
+		_mm256_storeu_ps(p.positionY + i, _mm256_add_ps(_mm256_loadu_ps(p.positionY + i), _mm256_mul_ps(vy, dt)));
+		_mm256_storeu_ps(p.positionZ + i, _mm256_add_ps(_mm256_loadu_ps(p.positionZ + i), _mm256_mul_ps(vz, dt)));
+		_mm256_storeu_ps(p.forceX + i, zero);
+		_mm256_storeu_ps(p.forceY + i, zero);
+		_mm256_storeu_ps(p.forceZ + i, zero);
+		__m256 alpha = _mm256_sub_ps(_mm256_loadu_ps(p.colorA + i), _mm256_mul_ps(_mm256_loadu_ps(p.fadeSpeed + i), fadeDt));
+		_mm256_storeu_ps(p.colorA + i, _mm256_max_ps(alpha, zero));
+	}
+	IntegrateSSE(p, i, end, params);
+}
+
+#endif /* CG_SIMD_X86 */
+
+// Widest path supported by both the CPU and the OS
+inline SimdPath DetectSimdPath()
+{
+#if defined(CG_SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+	const bool sse2 = (info[3] & (1 << 26)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+	return avx2 ? SimdPath::AVX2 : (sse2 ? SimdPath::SSE : SimdPath::SCALAR);
+#elif defined(CG_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return SimdPath::AVX2;
+	}
+	return __builtin_cpu_supports("sse2") ? SimdPath::SSE : SimdPath::SCALAR;
+#else
+	return SimdPath::SCALAR;
+#endif
+}
+
+// Kernel for a given path, falls back to scalar when the path is not compiled in
+inline IntegrateFunc SelectIntegrator(SimdPath path)
+{
+#ifdef CG_SIMD_X86
+	switch (path) {
+	case SimdPath::AVX2:
+		return IntegrateAVX2;
+	case SimdPath::SSE:
+		return IntegrateSSE;
+	default:
+		break;
+	}
+#endif
+	return IntegrateScalar;
+}
+
+// Fastest kernel of this machine, detected once on first use
+inline void Integrate(ParticleStore& p, int begin, int end, const StepParams& params)
+{
+	static const IntegrateFunc kernel = SelectIntegrator(DetectSimdPath());
+	kernel(p, begin, end, params);
+}
+
+// Micro-benchmark of every kernel available on this machine, prints particles/second
+inline void BenchmarkIntegrators(std::ostream& out, int particleNum = 1 << 20, int iterations = 200)
+{
+	ParticleStore store(particleNum);
+	ParticleStore::Fill(store.speedY, particleNum, 70.0f);
+	ParticleStore::Fill(store.colorA, particleNum, 1.0f);
+	ParticleStore::Fill(store.fadeSpeed, particleNum, 0.2f);
+	const StepParams params = { 0.016f, 2.0f, glm::vec3(0.0f, -9.8f, 0.0f), 0.016f };
+
+	const SimdPath best = DetectSimdPath();
+	// the caller's stream, its format is restored at the end
+	const std::ios_base::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << "Integrator benchmark: " << particleNum << " particles, " << iterations << " steps" << std::endl;
+	const SimdPath paths[] = { SimdPath::SCALAR, SimdPath::SSE, SimdPath::AVX2 };
+	for (SimdPath path : paths) {
+		if (int(path) > int(best)) {
+			out << "  " << std::setw(6) << SimdPathName(path) << ": not supported" << std::endl;
+			continue;
+		}
+		IntegrateFunc kernel = SelectIntegrator(path);
+		kernel(store, 0, particleNum, params); // warm up caches
+
+		Clock clock;
+		for (int i = 0; i < iterations; ++i) {
+			kernel(store, 0, particleNum, params);
+		}
+		const double seconds = clock.durationSecond();
+		out << "  " << std::setw(6) << SimdPathName(path) << ": "
+			<< std::fixed << std::setprecision(1) << double(particleNum) * iterations / seconds * 1e-6
+			<< " M particles/s" << std::endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+} /* namespace cg */
+
+#endif /* CG_INTEGRATOR_H_ */
@@ -0,0 +1,257 @@
+#ifndef CG_JOBSYSTEM_H_
+#define CG_JOBSYSTEM_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cg
+{
+
+/* Completion counter of a group of jobs.
+ * Every job submitted against a counter increments it, and it drops back to zero
+ * once all of them have run, so a caller can wait on exactly the work it needs.
+ */
+class JobCounter
+{
+	friend class JobSystem;
+	std::atomic<int> pending;
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+public:
+	JobCounter() : pending(0) {}
+
+	bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+/* Work-stealing job pool.
+ * Every worker owns a bounded deque: it pushes and pops its own jobs at the back,
+ * idle workers steal from the front of the others. Threads that are not workers
+ * (the render thread) share one deque and help running jobs while they wait.
+ * Dispatch() deals its chunks round-robin over all deques, so every worker starts on
+ * chunks of its own and only steals once those run out.
+ * Jobs are plain function pointers over a range, so scheduling never allocates.
+ */
+class JobSystem
+{
+public:
+	typedef void (*JobFunc)(void* data, int begin, int end);
+
+	static constexpr int QUEUE_CAPACITY = 4096;
+
+private:
+	struct Job
+	{
+		JobFunc func;
+		void* data;
+		int begin;
+		int end;
+		JobCounter* counter;
+	};
+
+	// bounded double-ended queue, back for the owner, front for thieves
+	class WorkQueue
+	{
+		std::mutex mutex;
+		std::unique_ptr<Job[]> ring;
+		int head; // index of the front job
+		int size;
+
+	public:
+		WorkQueue() : ring(new Job[QUEUE_CAPACITY]), head(0), size(0) {}
+
+		bool Push(const Job& job)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (size == QUEUE_CAPACITY) {
+				return false;
+			}
+			ring[(head + size) % QUEUE_CAPACITY] = job;
+			++size;
+			return true;
+		}
+
+		bool PopBack(Job& job)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (size == 0) {
+				return false;
+			}
+			--size;
+			job = ring[(head + size) % QUEUE_CAPACITY];
+			return true;
+		}
+
+		bool PopFront(Job& job)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (size == 0) {
+				return false;
+			}
+			job = ring[head];
+			head = (head + 1) % QUEUE_CAPACITY;
+			--size;
+			return true;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	std::unique_ptr<WorkQueue[]> queues; // queues[0] is shared by non-worker threads
+	int queueNum;
+
+	std::atomic<int> queued;
+	std::atomic<bool> stopping;
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+public:
+	// workerNum < 0: one worker per hardware thread besides the calling one
+	explicit JobSystem(int workerNum = -1) : queued(0), stopping(false)
+	{
+		if (workerNum < 0) {
+			workerNum = std::max(int(std::thread::hardware_concurrency()) - 1, 0);
+		}
+		queueNum = workerNum + 1;
+		queues.reset(new WorkQueue[queueNum]);
+		for (int i = 1; i <= workerNum; ++i) {
+			workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+		}
+	}
+
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wakeUp.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	int WorkerNum() const { return int(workers.size()); }
+
+	// Run func(data, begin, end) as one job
+	void Submit(JobCounter& counter, JobFunc func, void* data, int begin, int end)
+	{
+		if (Enqueue(CurrentQueue(), { func, data, begin, end, &counter })) {
+			WakeUp(false);
+		}
+	}
+
+	/* Split [0, count) into chunks of chunkSize, one job per chunk.
+	 * The chunks are dealt to the deques in turn starting with the caller's, then all workers are woken.
+	 */
+	void Dispatch(JobCounter& counter, int count, int chunkSize, JobFunc func, void* data)
+	{
+		bool queuedAny = false;
+		int queue = CurrentQueue();
+		for (int begin = 0; begin < count; begin += chunkSize) {
+			queuedAny |= Enqueue(queue, { func, data, begin, std::min(begin + chunkSize, count), &counter });
+			queue = (queue + 1) % queueNum;
+		}
+		if (queuedAny) {
+			WakeUp(true);
+		}
+	}
+
+	// Block until every job of counter has run, executing pending jobs meanwhile
+	void Wait(const JobCounter& counter)
+	{
+		const int self = CurrentQueue();
+		while (!counter.Done()) {
+			Job job;
+			if (TakeJob(self, job)) {
+				Run(job);
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+private:
+	static int& WorkerIndex()
+	{
+		static thread_local int index = 0;
+		return index;
+	}
+
+	int CurrentQueue() const { return WorkerIndex() < queueNum ? WorkerIndex() : 0; }
+
+	static void Run(const Job& job)
+	{
+		job.func(job.data, job.begin, job.end);
+		job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	// Count job against its counter & push it onto queues[queue]; false if it was run in place
+	bool Enqueue(int queue, const Job& job)
+	{
+		job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+		if (workers.empty() || !queues[queue].Push(job)) {
+			Run(job); // no worker or queue full: run in place
+			return false;
+		}
+		queued.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
+	void WakeUp(bool all)
+	{
+		{
+			// pairs with the predicate check of a sleeping worker, so the wake-up cannot be lost
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		if (all) {
+			wakeUp.notify_all();
+		} else {
+			wakeUp.notify_one();
+		}
+	}
+
+	bool TakeJob(int self, Job& job)
+	{
+		if (queues[self].PopBack(job)) {
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		for (int i = 1; i < queueNum; ++i) {
+			if (queues[(self + i) % queueNum].PopFront(job)) {
+				queued.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkerLoop(int index)
+	{
+		WorkerIndex() = index;
+		while (true) {
+			Job job;
+			if (TakeJob(index, job)) {
+				Run(job);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wakeUp.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+			if (stopping) {
+				return;
+			}
+		}
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_JOBSYSTEM_H_ */
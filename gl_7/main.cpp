@@ -1,7 +1,9 @@
 /*
  * OpenGL version 3.3 project.
  */
+#include <cassert>
 #include <iostream>
+#include <string>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -17,6 +19,16 @@
 
 #include "shader.hpp"
 #include "particalsys.hpp"
+#include "jobsystem.hpp"
+#include "particlerenderer.hpp"
+#include "gpufirework.hpp"
+#include "arena.hpp"
+#include "profiler.hpp"
+#include "benchmark.hpp"
+
+// count every heap allocation of the program, see the steady-state check of the frame loop
+#define CG_COUNT_ALLOCATIONS
+#include "allocationcounter.hpp"
 
 using namespace cg;
 
@@ -24,8 +36,26 @@ using namespace cg;
 int screenWidth = 800;
 int screenHeight = 600;
 
-FireWork** fireWorks;
 const int fireWorkNum = 3;
+const int sparkNum = 500; // particles of one burst
+
+// every firework spawns its particles in one pool, room for two bursts each
+// (a relaunch may explode before the sparks of the last burst have faded)
+const int particleCapacity = fireWorkNum * (sparkNum + 1) * 2;
+ParticlePool* particlePool;
+StepParams poolStep; // integration settings of the current frame
+
+// particles simulated per job
+const int simChunkSize = 1024;
+
+// frames allowed to allocate before the frame loop must stop allocating: the driver
+// may compile pipelines lazily during the first frames (and count them, llvmpipe does
+// through operator new), restarted when switching simulations
+const int warmUpFrames = 60;
+int warmUpLeft = warmUpFrames;
+
+// simulate on the GPU with transform feedback instead of the CPU, toggled with G
+bool gpuSimulation = false;
 
 GLfloat deltaTime = 0.0f;    // Time between current frame and last frame
 GLfloat lastFrame = 0.0f;      // Time of last frame
@@ -38,16 +68,42 @@ constexpr GLfloat vertices[] = {
 	0.0f,  0.5f,  0.0f, 0.0f, 0.0f, 1.0f   // Top 
 };
 
+// simulation job, integrates particles [begin, end) of particlePool
+void simulateChunk(void*, int begin, int end);
+
 // callbacks
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 
-int main()
+int main(int argc, char* argv[])
 {
+	std::string traceFile;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+		if (arg == "--bench") {
+			// run the particle integrator micro-benchmark instead of the scene
+			BenchmarkIntegrators(std::cout);
+			return 0;
+		} else if (arg == "--seed" && i + 1 < argc) {
+			// reproducible run: the same seed gives the same particles
+			Random::SetSeed(std::stoull(argv[++i]));
+		} else if (arg == "--gpu") {
+			// start with the GPU simulation
+			gpuSimulation = true;
+		} else if (arg == "--profile" && i + 1 < argc) {
+			// profile every frame, print the statistics & write a Chrome trace when leaving
+			traceFile = argv[++i];
+		}
+	}
+	Random sceneRandom = Random::Stream(0); // launch positions & lifetimes, fireworks use streams 1..n
+
+	// headless run of a fixed number of frames with --benchmark
+	Benchmark benchmark(argc, argv, "gl_7");
+
 	// Setup a GLFW window
 
 	// init GLFW, set GL version & pipeline info
-	glfwInit();
+	benchmark.Init();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -77,6 +133,10 @@ int main()
 		glfwTerminate();
 		return -2;
 	}
+	if (!benchmark.Attach(window)) {
+		glfwTerminate();
+		return -2;
+	}
 
 	// ---------------------------------------------------------------
 
@@ -93,53 +153,40 @@ int main()
 
     // ---------------------------------------------------------------
 
-    fireWorks = new FireWork * [fireWorkNum];
+    // the same fireworks on the GPU, both backends keep their own state
+    auto gpuFireWorks = GpuFireWorks::Create("ParticleUpdate.vert", fireWorkNum, sparkNum, glm::vec3(0.0, 70, 0.0), glm::vec3(0.0, -9.8, 0.0));
+    if (gpuFireWorks == nullptr) {
+        std::cerr << "GPU simulation unavailable, using the CPU" << std::endl;
+        gpuSimulation = false;
+    }
+
+    // the pool and every firework come from one block, released at once when leaving main()
+    Arena sceneArena(ParticlePool::ArenaSize(particleCapacity) + fireWorkNum * FireWork::ArenaSize(sparkNum));
+    particlePool = sceneArena.New<ParticlePool>(particleCapacity, &sceneArena);
+
+    FireWork* fireWorks[fireWorkNum];
     for (int i = 0; i < fireWorkNum; ++i)     {
-        fireWorks[i] = new FireWork(500, 0.5, glm::vec3(rand() % (screenWidth / 3) + screenWidth / 3 * i, screenHeight / 4, 0),
-                                    glm::vec3(0.0, 70, 0.0), glm::vec3(0.0, -9.8, 0.0), (double)rand() / (double)RAND_MAX * 2 + 12);
-        // massNum: 500, each firework consists of 500 particle
+        const glm::vec3 position(sceneRandom.NextInt(screenWidth / 3) + screenWidth / 3 * i, screenHeight / 4, 0);
+        const double life = sceneRandom.NextFloat(12.0f, 14.0f);
+        fireWorks[i] = sceneArena.New<FireWork>(*particlePool, sparkNum, 0.5, position, glm::vec3(0.0, 70, 0.0), glm::vec3(0.0, -9.8, 0.0), life, i + 1, &sceneArena);
+        // pool: arena of the particles
+        // massNum: sparkNum, each burst consists of sparkNum particles
         // mass: 5, each particle's mass is 5
         // position: start position
         // speed: initial speed is (0, 70, 0)
         // gravity: gravity is (0, -9.8, 0)
         // lifeValue: existing time in seconds
+        // stream: random stream of the firework
+        // arena: memory of the firework
+        if (gpuFireWorks != nullptr) {
+            gpuFireWorks->Launch(i, position, life, i + 1);
+        }
     }
 
-    GLfloat particle_quad[] = {
-        0.0f, 1.0f, 0.0f, 1.0f,
-        1.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 0.0f,
-
-        0.0f, 1.0f, 0.0f, 1.0f,
-        1.0f, 1.0f, 1.0f, 1.0f,
-        1.0f, 0.0f, 1.0f, 0.0f
-    };
-
-
 	// ---------------------------------------------------------------
 
-	// Set up vertex data (and buffer(s)) and attribute pointers
-
-	// bind VAO
-	GLuint VAO;
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-
-	// bind VBO, buffer data to it
-	GLuint VBO;
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
-
-	// set vertex attribute pointers
-	// position attribute
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// unbind VBO & VAO
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
+	// Set up the instanced renderer, one instance per particle of the pool
+	std::unique_ptr<ParticleRenderer> particleRenderer(new ParticleRenderer(particlePool->Capacity()));
 
     // ---------------------------------------------------------------
 
@@ -170,11 +217,23 @@ int main()
 	// Define the viewport dimensions
 	glViewport(0, 0, screenWidth, screenHeight);
 
+	// worker threads for the particle simulation
+	JobSystem jobs;
+	JobCounter simulated;
+	std::unique_ptr<glm::vec3[]> revivePositions(new glm::vec3[fireWorkNum]);
+
+	// CPU & GPU time of the simulation, upload and draw phases, only with --profile
+	std::unique_ptr<Profiler> profiler(new Profiler(!traceFile.empty()));
+
 	// Update loop
 
-	while (glfwWindowShouldClose(window) == 0) {
+	while (benchmark.Running(window)) {
+        const long long allocationsBefore = AllocationCounter::Allocations();
+        profiler->BeginFrame();
+        benchmark.Phase("Events");
+
         // Calculate deltatime of current frame
-        GLfloat currentFrame = glfwGetTime();
+        GLfloat currentFrame = benchmark.Time();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
@@ -190,51 +249,92 @@ int main()
 		glClearColor(red, green, blue, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        for (int i = 0; i < fireWorkNum; ++i) {
-            fireWorks[i]->Process(deltaTime * 3, glm::vec3(rand() % (screenWidth / 3) + screenWidth / 3 * i, screenHeight / 4, 0)); // apply gravity and update speed, position
-        }
-
-        // Draw
+        // Draw settings
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE);
         glm::mat4 projection = glm::ortho(0.0f, GLfloat(screenWidth), 0.0f, GLfloat(screenHeight), -1.0f, 100.0f);
         shaderProgram->Use();
-        GLint projLoc = glGetUniformLocation(shaderProgram->Program(), "projection");
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-        for (int i = 0; i < fireWorkNum; ++i)         {
-            if (fireWorks[i]->hasExploded) {
-                for (int j = 0; j < fireWorks[i]->GetMassNum(); ++j) {
-                    GLint offsetLoc = glGetUniformLocation(shaderProgram->Program(), "offset");
-                    glUniform2f(offsetLoc, fireWorks[i]->GetMass(j)->position[0], fireWorks[i]->GetMass(j)->position[1]);
-                    GLint colorLoc = glGetUniformLocation(shaderProgram->Program(), "color");
-                    glUniform4f(colorLoc, fireWorks[i]->GetMass(j)->color.r, fireWorks[i]->GetMass(j)->color.g, fireWorks[i]->GetMass(j)->color.b,
-                                fireWorks[i]->GetMass(j)->color.a);
-                    glBindTexture(GL_TEXTURE_2D, texture);
-                    glBindVertexArray(VAO);
-                    glDrawArrays(GL_TRIANGLES, 0, 6);
-                    glBindVertexArray(0);
+        shaderProgram->Set("projection", projection);
+
+        if (gpuSimulation && gpuFireWorks != nullptr) {
+            {
+                // transform feedback pass, no particle leaves GPU memory
+                CpuScope cpuScope(*profiler, "Simulate");
+                GpuScope gpuScope(*profiler, "Simulate");
+                benchmark.Phase("Simulate");
+                for (int i = 0; i < fireWorkNum; ++i) {
+                    revivePositions[i] = glm::vec3(sceneRandom.NextInt(screenWidth / 3) + screenWidth / 3 * i, screenHeight / 4, 0);
+                }
+                gpuFireWorks->Process(deltaTime * 3, revivePositions.get());
+            }
+            {
+                // particles hidden before the explosion have zero alpha
+                CpuScope cpuScope(*profiler, "Draw");
+                GpuScope gpuScope(*profiler, "Draw");
+                benchmark.Phase("Draw");
+                shaderProgram->Use();
+                gpuFireWorks->Draw(*particleRenderer, texture);
+            }
+        } else {
+            {
+                // explode & apply gravity, then simulate the alive particles of all fireworks in parallel chunks
+                CpuScope cpuScope(*profiler, "Simulate");
+                benchmark.Phase("Simulate");
+                for (int i = 0; i < fireWorkNum; ++i) {
+                    fireWorks[i]->Apply();
+                }
+                poolStep = StepParams{ deltaTime * 3, GLfloat(1 / 0.5), glm::vec3(0.0f), deltaTime * 3 };
+                jobs.Dispatch(simulated, particlePool->LiveNum(), simChunkSize, simulateChunk, nullptr); // update speed, position, fade
+                // while the workers simulate: map this frame's instances, which may wait on the GPU fence
+                // of an older frame, then help with the remaining chunks
+                particleRenderer->Begin();
+                jobs.Wait(simulated);
+                particlePool->KillFaded(); // recycle faded sparks
+                for (int i = 0; i < fireWorkNum; ++i) {
+                    fireWorks[i]->Update(deltaTime * 3, glm::vec3(sceneRandom.NextInt(screenWidth / 3) + screenWidth / 3 * i, screenHeight / 4, 0));
                 }
-            } else {// before explosion, only one point
-                int j = 0;
-                GLint offsetLoc = glGetUniformLocation(shaderProgram->Program(), "offset");
-                glUniform2f(offsetLoc, fireWorks[i]->GetMass(j)->position[0], fireWorks[i]->GetMass(j)->position[1]);
-                GLint colorLoc = glGetUniformLocation(shaderProgram->Program(), "color");
-                glUniform4f(colorLoc, fireWorks[i]->GetMass(j)->color.r, fireWorks[i]->GetMass(j)->color.g, fireWorks[i]->GetMass(j)->color.b,
-                            fireWorks[i]->GetMass(j)->color.a);
-                glBindTexture(GL_TEXTURE_2D, texture);
-                glBindVertexArray(VAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-                glBindVertexArray(0);
+            }
+            {
+                // alive particles are compacted at the front of the pool
+                CpuScope cpuScope(*profiler, "Upload");
+                benchmark.Phase("Upload");
+                particleRenderer->Add(particlePool->Particles(), particlePool->LiveNum());
+            }
+            {
+                CpuScope cpuScope(*profiler, "Draw");
+                GpuScope gpuScope(*profiler, "Draw");
+                benchmark.Phase("Draw");
+                particleRenderer->Draw(texture);
             }
         }
 
 		// swap buffer
-		glfwSwapBuffers(window);
+		benchmark.SwapBuffers(window);
+        profiler->EndFrame();
+
+        // steady state: once warmed up, a frame must not allocate
+        const long long frameAllocations = AllocationCounter::Allocations() - allocationsBefore;
+        if (warmUpLeft > 0) {
+            --warmUpLeft;
+        } else if (frameAllocations != 0) {
+            std::cerr << "Frame loop allocated " << frameAllocations << " times in one frame" << std::endl;
+            assert(frameAllocations == 0);
+        }
+	}
+
+	if (profiler->Enabled()) {
+		profiler->Flush();
+		profiler->Print(std::cout);
+		profiler->WriteChromeTrace(traceFile);
 	}
+	benchmark.Report();
 
 	// properly de-allocate all resources
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
+	profiler.reset();
+	particleRenderer.reset();
+	gpuFireWorks.reset();
+	glDeleteTextures(1, &texture);
+	particlePool->PrintStatistics(std::cout);
 
 	glfwTerminate();
 	return 0;
@@ -242,12 +342,27 @@ int main()
 
 /* ======================== helper functions ======================== */
 
+void simulateChunk(void*, int begin, int end)
+{
+	Integrate(particlePool->Particles(), begin, end, poolStep);
+}
+
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode)
 {
 	// exit when pressing ESC
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, GL_TRUE);
 	}
+	// switch between the CPU & GPU particle simulation
+	if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+		gpuSimulation = !gpuSimulation;
+		warmUpLeft = warmUpFrames;
+		std::cout << "Particle simulation: " << (gpuSimulation ? "GPU" : "CPU") << std::endl;
+	}
+	// live / dead counts of the CPU particle arena
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		particlePool->PrintStatistics(std::cout);
+	}
 }
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
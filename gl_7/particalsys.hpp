@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <memory>
 
 #include <glad/glad.h>
 
@@ -10,152 +11,74 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "particlestore.hpp"
+#include "particlepool.hpp"
+#include "integrator.hpp"
+#include "random.hpp"
+
 namespace cg
 {
 
 constexpr const double PI = 3.14159265358979;
 
-class Mass
-{
-public:
-	double mass;
-	glm::vec3 position;
-	glm::vec3 speed;
-	glm::vec3 force;
-	glm::vec4 color;
-	double fadeSpeed;
-	double life;
-
-public:
-	Mass() : mass(0), speed(0), position(0), force(0), color(0), fadeSpeed(0), life(0) { }
-
-	Mass(double mass, glm::vec3 position, glm::vec3 speed, double life) : color(0), force(0), fadeSpeed(0)
-	{
-		this->mass = mass;
-		this->position = position;
-		this->speed = speed;
-		this->life = life;
-	}
-
-	void init()
-	{
-		force = glm::vec3(0.0, 0.0, 0.0);
-	}
-
-	void update(double dt)
-	{
-		speed += force / GLfloat(mass) * GLfloat(dt);
-		position += speed * GLfloat(dt);
-	}
-
-	void applyForce(glm::vec3 newForce)
-	{
-		this->force += newForce;
-	}
-
-	virtual void apply() { };
-
-	void Process(double dt)
-	{
-		init();
-		apply();
-		update(dt);
-	}
-};
-
-class BunchOfMass
+/* Firework emitter, its particles live in a ParticlePool shared with other emitters.
+ * A launch spawns one rocket particle. Once it has slowed down the rocket is killed and
+ * a burst of massNum sparks is spawned in its place, the sparks fade out and return to
+ * the pool on their own. When its life is over the firework launches a new rocket, so
+ * bursts of consecutive launches may overlap and nothing is allocated after construction.
+ * Given an Arena, the firework takes its scratch memory from it.
+ */
+class FireWork
 {
-protected:
-	int massNum;
-	Mass** masses;
-
-public:
-	BunchOfMass(int massNum, double m, glm::vec3 position, glm::vec3 speed, double life)
-	{
-		this->massNum = massNum;
-		masses = new Mass*[massNum];
-		if (masses) {
-			for (int i = 0; i < massNum; ++i) {
-				masses[i] = new Mass(m, position, speed, life);
-			}
-		}
-	}
-
-	~BunchOfMass()
-	{
-		if (masses) {
-			for (int i = 0; i < massNum; ++i) {
-				delete[] masses[i];
-			}
-			delete[] masses;
-		}
-	}
-
-	Mass* GetMass(int idx)
-	{
-		return masses[idx];
-	}
-
-	void init()
-	{
-		for (int i = 0; i < massNum; ++i) {
-			masses[i]->init(); //set force to zero
-		}
-	}
+	ParticlePool& pool;
+	int massNum; // sparks per burst
+	double mass; // every particle has the same mass
 
-	virtual void Apply() = 0;
-
-	virtual void Update(double dt, glm::vec3 newpos)
-	{
-		for (int i = 0; i < massNum; ++i) {
-			// update speed and position
-			// speed += (F/m) * dt
-			// position += speed * dt
-			masses[i]->update(dt); 
-		}
-	}
-
-	void Process(double dt, glm::vec3 newpos)
-	{
-		init(); // set force to zero
-		Apply(); // apply force (add force)
-		Update(dt, newpos); // update speed and position
-	}
-};
-
-class FireWork : public BunchOfMass
-{
-	glm::vec3 gravAcceleratio, constGravAcceleratio;
+	glm::vec3 gravAcceleratio;
 	double lifeLeft;
 
 	glm::vec3 initialSpeed;
-	glm::vec3 initialPosition;
 	double initialLife;
 
+	ParticlePool::Handle rocket;
+	glm::vec3 color;
+
+	RandomBatch rng; // own random stream, independent of every other firework
+	std::unique_ptr<GLfloat[]> ownSpray; // empty when spray lives in an arena
+	GLfloat* spray; // random numbers of one burst
+
 public:
 	bool hasExploded;
 
 public:
-	FireWork(int massNum, double m, glm::vec3 position, glm::vec3 speed,
-			 glm::vec3 gravity, double lifeValue) :
-		BunchOfMass(massNum, m, position, speed, lifeValue), hasExploded(false)
+	// stream: id of the random stream of this firework, see Random::SetSeed() for reproducible runs
+	// arena: where the scratch memory is allocated, nullptr for the heap
+	FireWork(ParticlePool& pool, int massNum, double m, glm::vec3 position, glm::vec3 speed,
+			 glm::vec3 gravity, double lifeValue, std::uint64_t stream = 0, Arena* arena = nullptr) :
+		pool(pool), massNum(massNum), mass(m), rocket(ParticlePool::INVALID),
+		rng(RandomBatch::Stream(stream)), spray(nullptr), hasExploded(false)
 	{
+		if (arena != nullptr) {
+			spray = arena->Allocate<GLfloat>(3 * size_t(massNum));
+		}
+		if (spray == nullptr) {
+			ownSpray.reset(new GLfloat[3 * size_t(massNum)]);
+			spray = ownSpray.get();
+		}
+
 		gravAcceleratio = gravity;
-		constGravAcceleratio = gravity;
 		lifeLeft = lifeValue;
 
-		initialPosition = position;
 		initialSpeed = speed;
 		initialLife = lifeLeft;
 
-		double r = rand() % 255;
-		double g = rand() % 255;
-		double b = rand() % 255;
-		for (int i = 0; i < massNum; ++i) 		{
-			masses[i]->color = glm::vec4(r / 255., g / 255., b / 255., 1.0);
-			masses[i]->fadeSpeed = rand() % 2 ? 50 / 255. : 40 / 255.;
-			masses[i]->life = lifeLeft;
-		}
+		Launch(position);
+	}
+
+	// Arena bytes taken by a firework of massNum sparks, the firework object included
+	static size_t ArenaSize(int massNum)
+	{
+		return Arena::NewFootprint<FireWork>() + Arena::Footprint<GLfloat>(3 * size_t(massNum));
 	}
 
 	int GetMassNum()
@@ -163,67 +86,102 @@ public:
 		return massNum;
 	}
 
-	virtual void Apply()
+	// apply force (add force) or explode, runs once per frame before the pool is integrated
+	void Apply()
 	{
-		for (int i = 0; i < massNum; ++i) // apply gravity
-		{
-			masses[i]->applyForce(gravAcceleratio * GLfloat(masses[i]->mass));
+		if (rocket == ParticlePool::INVALID) {
+			return;
 		}
+		ParticleStore& p = pool.Particles();
+		const int slot = pool.Slot(rocket);
+		if (!hasExploded && p.speedY[slot] < 10) { // time to explode
+			Explode(p.Position(slot));
+			return;
+		}
+
+		// only the rocket falls, sparks keep their speed
+		p.forceX[slot] += GLfloat(mass * gravAcceleratio.x);
+		p.forceY[slot] += GLfloat(mass * gravAcceleratio.y);
+		p.forceZ[slot] += GLfloat(mass * gravAcceleratio.z);
+	}
+
+	// runs once per frame after the pool has been integrated
+	void Update(double dt, glm::vec3 newPos)
+	{
+		lifeLeft -= dt;
 
-		if (!hasExploded && masses[0]->speed[1] < 10) // time to explode
+		if (lifeLeft < 1e-2) // launch again
 		{
-			for (int i = 0; i < massNum; ++i) // simulate uniform spray
-			{
-				double radius = rand() % 30;
-				double angle1 = rand() % 360;
-				double angle2 = rand() % 360;
-
-				//a random direction
-				glm::vec3 dir = glm::vec3(radius * cos(angle2 * PI / 180) * cos(angle1 * PI / 180),
-										  radius * cos(angle2 * PI / 180) * sin(angle1 * PI / 180),
-										  radius * sin(angle2 * PI / 180));
-				dir = glm::normalize(dir);
-				dir *= 10;
-
-				gravAcceleratio = glm::vec3(0, 0, 0);
-				masses[i]->speed = glm::vec3(0, 0, 0);
-				masses[i]->speed += dir;
-				hasExploded = true;
+			if (rocket != ParticlePool::INVALID) {
+				pool.Kill(rocket);
 			}
+			Launch(newPos);
+			lifeLeft = initialLife;
 		}
 	}
 
-	virtual void Update(double dt, glm::vec3 newPos)
+private:
+	void Launch(glm::vec3 position)
 	{
-		// update speed and position
-		BunchOfMass::Update(dt, newPos);
+		color = RandomColor();
+		hasExploded = false;
+		rocket = pool.Spawn();
+		if (rocket == ParticlePool::INVALID) {
+			return;
+		}
 
-		lifeLeft -= dt;
+		// a rocket never fades
+		ParticleStore& p = pool.Particles();
+		const int slot = pool.Slot(rocket);
+		p.SetPosition(slot, position);
+		p.SetSpeed(slot, initialSpeed);
+		p.SetColor(slot, glm::vec4(color, 1.0f));
+		p.life[slot] = GLfloat(lifeLeft);
+	}
 
-		if (hasExploded) {
-			for (int i = 0; i < massNum; ++i) {
-				masses[i]->color.a -= masses[i]->fadeSpeed * dt; // here alpha is transparency
-				if (masses[i]->color.a < 0) masses[i]->color.a = 0;
-			}
-		}
-		if (lifeLeft < 1e-2) // revive
-		{
-			double r = rand() % 255;
-			double g = rand() % 255;
-			double b = rand() % 255;
-			for (int i = 0; i < massNum; ++i) {
-				masses[i]->speed = initialSpeed;
-				masses[i]->color = glm::vec4(r / 255., g / 255., b / 255., 1.0);
-				masses[i]->position = newPos;
+	void Explode(glm::vec3 position)
+	{
+		pool.Kill(rocket);
+		rocket = ParticlePool::INVALID;
+		hasExploded = true;
+
+		// simulate uniform spray: two random angles per spark & a fade speed,
+		// generated for the whole burst at once
+		GLfloat* angles1 = spray;
+		GLfloat* angles2 = angles1 + massNum;
+		GLfloat* fades = angles2 + massNum;
+		rng.Fill(angles1, 2 * massNum, 0.0f, GLfloat(2 * PI));
+		rng.Fill(fades, massNum);
+
+		ParticleStore& p = pool.Particles();
+		for (int i = 0; i < massNum; ++i) {
+			const ParticlePool::Handle spark = pool.Spawn();
+			if (spark == ParticlePool::INVALID) {
+				break; // arena full, the burst is smaller
 			}
-			gravAcceleratio = constGravAcceleratio;
-			lifeLeft = initialLife;
-			hasExploded = false;
+			const int slot = pool.Slot(spark);
+
+			//a random direction of length 10
+			const GLfloat angle1 = angles1[i];
+			const GLfloat angle2 = angles2[i];
+			p.SetPosition(slot, position);
+			p.SetSpeed(slot, glm::vec3(10 * std::cos(angle2) * std::cos(angle1),
+									   10 * std::cos(angle2) * std::sin(angle1),
+									   10 * std::sin(angle2)));
+			p.SetColor(slot, glm::vec4(color, 1.0f));
+			p.fadeSpeed[slot] = GLfloat(fades[i] < 0.5f ? 50 / 255. : 40 / 255.);
+			p.life[slot] = GLfloat(lifeLeft);
 		}
 	}
+
+	glm::vec3 RandomColor()
+	{
+		GLfloat rgb[3];
+		rng.Fill(rgb, 3);
+		return glm::vec3(rgb[0], rgb[1], rgb[2]);
+	}
 };
 
 }
 
 #endif // CG_PARTICALSYS_H_
-
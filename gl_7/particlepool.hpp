@@ -0,0 +1,167 @@
+#ifndef CG_PARTICLEPOOL_H_
+#define CG_PARTICLEPOOL_H_
+
+#include <iostream>
+#include <memory>
+
+#include "particlestore.hpp"
+
+namespace cg
+{
+
+/* Fixed-capacity particle arena shared by any number of emitters.
+ * Alive particles are always compacted in slots [0, LiveNum()) of the store, so the
+ * simulation and the renderer walk one dense range: Spawn() appends a slot and Kill()
+ * moves the last alive particle into the hole, both O(1) and allocation free.
+ *
+ * Slots move when particles die, emitters that need to follow one particle keep its
+ * Handle instead. Handles are recycled through a free list.
+ * Given an Arena, the pool takes all its memory from it.
+ */
+class ParticlePool
+{
+public:
+	typedef int Handle;
+	static constexpr Handle INVALID = -1;
+
+private:
+	int capacity;
+	ParticleStore particles;
+	std::unique_ptr<int[]> indices; // empty when the tables live in an arena
+	int* slotOf;   // handle -> slot, or next free handle when dead
+	int* handleOf; // slot -> handle
+	Handle freeHead; // first free handle
+	int liveNum;
+
+	// statistics
+	int highWater;  // most particles alive at once
+	long long spawned;
+	long long killed;
+	long long dropped; // spawns refused because the arena was full
+
+	ParticlePool(const ParticlePool&) = delete;
+	ParticlePool& operator=(const ParticlePool&) = delete;
+
+public:
+	// arena: where the particles & tables are allocated, nullptr for the heap
+	explicit ParticlePool(int capacity, Arena* arena = nullptr) :
+		capacity(capacity), particles(capacity, arena), slotOf(nullptr),
+		freeHead(capacity > 0 ? 0 : INVALID), liveNum(0), highWater(0), spawned(0), killed(0), dropped(0)
+	{
+		if (arena != nullptr) {
+			slotOf = arena->Allocate<int>(2 * size_t(capacity));
+		}
+		if (slotOf == nullptr) {
+			indices.reset(new int[2 * size_t(capacity)]);
+			slotOf = indices.get();
+		}
+		handleOf = slotOf + capacity;
+
+		// every handle starts free, chained in order
+		for (int i = 0; i < capacity; ++i) {
+			slotOf[i] = i + 1 < capacity ? i + 1 : INVALID;
+			handleOf[i] = INVALID;
+		}
+	}
+
+	// Arena bytes taken by a pool of capacity particles, the pool object included
+	static size_t ArenaSize(int capacity)
+	{
+		return Arena::NewFootprint<ParticlePool>() + ParticleStore::ArenaSize(capacity) + Arena::Footprint<int>(2 * size_t(capacity));
+	}
+
+	ParticleStore& Particles() { return particles; }
+	const ParticleStore& Particles() const { return particles; }
+
+	int Capacity() const { return capacity; }
+	int LiveNum() const { return liveNum; }
+	int DeadNum() const { return capacity - liveNum; }
+	int HighWater() const { return highWater; }
+	long long Spawned() const { return spawned; }
+	long long Killed() const { return killed; }
+	long long Dropped() const { return dropped; }
+
+	// Slot of an alive particle in Particles()
+	int Slot(Handle handle) const { return slotOf[handle]; }
+
+	// Handle of the particle in slot
+	Handle HandleAt(int slot) const { return handleOf[slot]; }
+
+	/* New particle with every attribute zero, at slot LiveNum() - 1.
+	 * Returns INVALID when the arena is full.
+	 */
+	Handle Spawn()
+	{
+		if (freeHead == INVALID) {
+			++dropped;
+			return INVALID;
+		}
+		const Handle handle = freeHead;
+		freeHead = slotOf[handle];
+
+		const int slot = liveNum++;
+		slotOf[handle] = slot;
+		handleOf[slot] = handle;
+		particles.Clear(slot);
+
+		++spawned;
+		if (liveNum > highWater) {
+			highWater = liveNum;
+		}
+		return handle;
+	}
+
+	void Kill(Handle handle)
+	{
+		KillSlot(slotOf[handle]);
+	}
+
+	/* Kill the particle in slot, the last alive particle takes its place.
+	 * When sweeping, walk the slots backwards so no particle is skipped.
+	 */
+	void KillSlot(int slot)
+	{
+		const Handle handle = handleOf[slot];
+		const int last = --liveNum;
+		if (slot != last) {
+			particles.Copy(last, slot);
+			handleOf[slot] = handleOf[last];
+			slotOf[handleOf[slot]] = slot;
+		}
+		handleOf[last] = INVALID;
+
+		slotOf[handle] = freeHead;
+		freeHead = handle;
+		++killed;
+	}
+
+	// Kill every particle whose alpha has faded to zero, returns how many died
+	int KillFaded()
+	{
+		int num = 0;
+		for (int slot = liveNum - 1; slot >= 0; --slot) {
+			if (particles.colorA[slot] <= 0.0f) {
+				KillSlot(slot);
+				++num;
+			}
+		}
+		return num;
+	}
+
+	void ResetStatistics()
+	{
+		highWater = liveNum;
+		spawned = killed = dropped = 0;
+	}
+
+	void PrintStatistics(std::ostream& out) const
+	{
+		out << "Particle pool: " << liveNum << " live, " << DeadNum() << " dead of " << capacity
+			<< ", high-water " << highWater << ", spawned " << spawned << ", killed " << killed
+			<< ", dropped " << dropped << std::endl;
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_PARTICLEPOOL_H_ */
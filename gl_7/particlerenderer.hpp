@@ -0,0 +1,146 @@
+#ifndef CG_PARTICLERENDERER_H_
+#define CG_PARTICLERENDERER_H_
+
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "particlestore.hpp"
+#include "uploadring.hpp"
+
+namespace cg
+{
+
+/* Instanced particle renderer.
+ * Particles of any number of systems are packed into one per-instance buffer
+ * <vec2 offset, vec4 color> per frame and drawn with a single glDrawArraysInstanced
+ * of a textured quad, instead of one draw call per particle.
+ * Instances are written straight into GPU-visible memory of an UploadRing.
+ */
+class ParticleRenderer
+{
+public:
+	// floats per instance: offset.xy, color.rgba
+	static constexpr int INSTANCE_FLOATS = 6;
+
+private:
+	GLuint VAO;
+	GLuint quadVBO;
+	UploadRing instanceRing;
+	int capacity; // instances per frame, the rest are dropped
+	int instanceNum;
+	GLfloat* instances; // mapped instance data of the current frame
+	GLintptr instanceOffset;
+
+	ParticleRenderer(const ParticleRenderer&) = delete;
+	ParticleRenderer& operator=(const ParticleRenderer&) = delete;
+
+public:
+	explicit ParticleRenderer(int capacity) :
+		instanceRing(GL_ARRAY_BUFFER, capacity * INSTANCE_FLOATS * sizeof(GLfloat)),
+		capacity(capacity), instanceNum(0), instances(nullptr), instanceOffset(0)
+	{
+		// <vec2 position, vec2 texCoords> of a unit quad
+		const GLfloat particleQuad[] = {
+			0.0f, 1.0f, 0.0f, 1.0f,
+			1.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f,
+
+			0.0f, 1.0f, 0.0f, 1.0f,
+			1.0f, 1.0f, 1.0f, 1.0f,
+			1.0f, 0.0f, 1.0f, 0.0f
+		};
+
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+
+		// per-vertex quad
+		glGenBuffers(1, &quadVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(particleQuad), particleQuad, GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+		glEnableVertexAttribArray(0);
+
+		// per-instance offset & color, pointers are set per frame in Draw()
+		glEnableVertexAttribArray(1);
+		glVertexAttribDivisor(1, 1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribDivisor(2, 1);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
+	~ParticleRenderer()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &quadVBO);
+	}
+
+	int InstanceNum() const { return instanceNum; }
+
+	// Start collecting the particles of a new frame
+	void Begin()
+	{
+		instanceNum = 0;
+		instanceRing.BeginFrame();
+		instances = static_cast<GLfloat*>(instanceRing.Map(capacity * INSTANCE_FLOATS * sizeof(GLfloat), instanceOffset));
+	}
+
+	// Queue the first num particles of a store
+	void Add(const ParticleStore& p, int num)
+	{
+		num = std::min(num, instances != nullptr ? capacity - instanceNum : 0);
+		GLfloat* out = instances + instanceNum * INSTANCE_FLOATS;
+		for (int i = 0; i < num; ++i, out += INSTANCE_FLOATS) {
+			out[0] = p.positionX[i];
+			out[1] = p.positionY[i];
+			out[2] = p.colorR[i];
+			out[3] = p.colorG[i];
+			out[4] = p.colorB[i];
+			out[5] = p.colorA[i];
+		}
+		instanceNum += num;
+	}
+
+	// Draw every queued particle with one call, the shader program must be in use
+	void Draw(GLuint texture)
+	{
+		instanceRing.Unmap();
+		// this frame's instances start at instanceOffset of the ring
+		DrawInstances(instanceRing.Buffer(), instanceOffset, INSTANCE_FLOATS * sizeof(GLfloat), 2 * sizeof(GLfloat), instanceNum, texture);
+		instanceRing.EndFrame();
+	}
+
+	/* Draw num instances that already live in a GPU buffer, without Begin() / Add().
+	 * Every instance is stride bytes starting at offset, holding its vec2 position first
+	 * and its vec4 color colorOffset bytes further.
+	 */
+	void DrawBuffer(GLuint buffer, GLintptr offset, GLsizei stride, GLintptr colorOffset, int num, GLuint texture)
+	{
+		DrawInstances(buffer, offset, stride, colorOffset, num, texture);
+	}
+
+private:
+	void DrawInstances(GLuint buffer, GLintptr offset, GLsizei stride, GLintptr colorOffset, int num, GLuint texture)
+	{
+		if (num <= 0) {
+			return;
+		}
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset + colorOffset));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, num);
+		glBindVertexArray(0);
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_PARTICLERENDERER_H_ */
@@ -0,0 +1,130 @@
+#ifndef CG_PARTICLESTORE_H_
+#define CG_PARTICLESTORE_H_
+
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "arena.hpp"
+
+namespace cg
+{
+
+/* Structure-of-arrays storage for a group of particles.
+ * Every attribute lives in its own tightly packed array inside a single
+ * contiguous block, so per-particle loops stream linearly through memory
+ * instead of chasing one heap object per particle.
+ * The block is owned by the store, or taken from an Arena shared with other systems.
+ */
+class ParticleStore
+{
+public:
+	// each array starts on a cache line boundary
+	static constexpr int ALIGNMENT = 64;
+	static constexpr int ARRAY_NUM = 15;
+
+	GLfloat* positionX;
+	GLfloat* positionY;
+	GLfloat* positionZ;
+	GLfloat* speedX;
+	GLfloat* speedY;
+	GLfloat* speedZ;
+	GLfloat* forceX;
+	GLfloat* forceY;
+	GLfloat* forceZ;
+	GLfloat* colorR;
+	GLfloat* colorG;
+	GLfloat* colorB;
+	GLfloat* colorA;
+	GLfloat* fadeSpeed;
+	GLfloat* life;
+
+private:
+	int count;
+	int stride; // padded length of every array, in floats
+	std::unique_ptr<GLfloat[]> block; // empty when the arrays live in an arena
+
+	ParticleStore(const ParticleStore&) = delete;
+	ParticleStore& operator=(const ParticleStore&) = delete;
+
+public:
+	// arena: where the arrays are allocated, nullptr for the heap
+	explicit ParticleStore(int count, Arena* arena = nullptr) : count(count)
+	{
+		stride = Stride(count);
+		const size_t floatNum = size_t(stride) * ARRAY_NUM;
+
+		GLfloat* base = arena != nullptr ? static_cast<GLfloat*>(arena->Allocate(floatNum * sizeof(GLfloat), ALIGNMENT)) : nullptr;
+		if (base != nullptr) {
+			std::fill(base, base + floatNum, 0.0f);
+		} else {
+			constexpr int lineFloats = ALIGNMENT / sizeof(GLfloat);
+			block.reset(new GLfloat[floatNum + lineFloats]());
+
+			// align the first array, the others follow at whole cache lines
+			std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(block.get());
+			base = block.get() + (ALIGNMENT - addr % ALIGNMENT) % ALIGNMENT / sizeof(GLfloat);
+		}
+
+		GLfloat** arrays[ARRAY_NUM] = {
+			&positionX, &positionY, &positionZ,
+			&speedX, &speedY, &speedZ,
+			&forceX, &forceY, &forceZ,
+			&colorR, &colorG, &colorB, &colorA,
+			&fadeSpeed, &life
+		};
+		for (int i = 0; i < ARRAY_NUM; ++i) {
+			*arrays[i] = base + size_t(stride) * i;
+		}
+	}
+
+	// Arena bytes taken by the arrays of count particles
+	static size_t ArenaSize(int count)
+	{
+		return Arena::Footprint(size_t(Stride(count)) * ARRAY_NUM * sizeof(GLfloat), ALIGNMENT);
+	}
+
+	int Size() const { return count; }
+
+	glm::vec3 Position(int idx) const { return glm::vec3(positionX[idx], positionY[idx], positionZ[idx]); }
+	glm::vec3 Speed(int idx) const { return glm::vec3(speedX[idx], speedY[idx], speedZ[idx]); }
+	glm::vec4 Color(int idx) const { return glm::vec4(colorR[idx], colorG[idx], colorB[idx], colorA[idx]); }
+
+	void SetPosition(int idx, const glm::vec3& v) { positionX[idx] = v.x; positionY[idx] = v.y; positionZ[idx] = v.z; }
+	void SetSpeed(int idx, const glm::vec3& v) { speedX[idx] = v.x; speedY[idx] = v.y; speedZ[idx] = v.z; }
+	void SetColor(int idx, const glm::vec4& c) { colorR[idx] = c.r; colorG[idx] = c.g; colorB[idx] = c.b; colorA[idx] = c.a; }
+
+	// every attribute of particle from -> particle to
+	void Copy(int from, int to)
+	{
+		for (int i = 0; i < ARRAY_NUM; ++i) {
+			positionX[size_t(stride) * i + to] = positionX[size_t(stride) * i + from];
+		}
+	}
+
+	// every attribute of particle idx = 0
+	void Clear(int idx)
+	{
+		for (int i = 0; i < ARRAY_NUM; ++i) {
+			positionX[size_t(stride) * i + idx] = 0.0f;
+		}
+	}
+
+	// padded length of the arrays of count particles, in floats
+	static int Stride(int count)
+	{
+		constexpr int lineFloats = ALIGNMENT / sizeof(GLfloat);
+		return (count + lineFloats - 1) / lineFloats * lineFloats;
+	}
+
+	// fill one attribute array with the same value
+	static void Fill(GLfloat* array, int num, GLfloat value) { std::fill(array, array + num, value); }
+};
+
+} /* namespace cg */
+
+#endif /* CG_PARTICLESTORE_H_ */
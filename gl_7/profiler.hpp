@@ -0,0 +1,417 @@
+#ifndef CG_PROFILER_H_
+#define CG_PROFILER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <glad/glad.h>
+
+#include "clock.hpp"
+
+namespace cg
+{
+
+/* Hierarchical frame profiler.
+ * CPU scopes are timed with a Clock, GPU scopes with GL_TIME_ELAPSED queries kept in a
+ * ring of GPU_FRAMES frames: a query is read back GPU_FRAMES frames after it was issued,
+ * and skipped if still not available, so reading results never stalls the pipeline.
+ * Every scope keeps min / avg / max and a log-scale histogram for percentiles, and
+ * every measurement is kept as an event for WriteChromeTrace() (chrome://tracing).
+ *
+ * Scopes are named by string literals and must be opened on the render thread.
+ * GL_TIME_ELAPSED queries cannot nest: a GPU scope opened inside another one is skipped.
+ * GPU scopes add no flush: on deferred renderers (llvmpipe, tilers) a scope measures the
+ * work the driver ran inside it, which may be less than the commands issued in it.
+ * All memory is allocated up front, profiling a frame never allocates.
+ */
+class Profiler
+{
+public:
+	static constexpr int MAX_SCOPES = 64;
+	static constexpr int GPU_FRAMES = 4;            // frames in flight of the query ring
+	static constexpr int GPU_QUERIES_PER_FRAME = 32;
+
+	// histogram: BUCKETS_PER_OCTAVE linear buckets per power of two nanoseconds
+	static constexpr int BUCKETS_PER_OCTAVE = 8;
+	static constexpr int OCTAVES = 40;
+	static constexpr int BUCKET_NUM = BUCKETS_PER_OCTAVE * OCTAVES;
+
+private:
+	struct Stats
+	{
+		const char* name;
+		bool gpu;
+		int depth; // nesting level of the first measurement
+		long long count;
+		long long minNs;
+		long long maxNs;
+		double sumNs;
+		std::uint32_t buckets[BUCKET_NUM];
+	};
+
+	struct Event
+	{
+		int scope;
+		long long startNs;
+		long long durationNs;
+	};
+
+	struct GpuQuery
+	{
+		GLuint query;
+		int scope;
+		long long submitNs; // CPU time the scope was opened, position of its event
+	};
+
+	Clock clock;
+	bool enabled;
+
+	std::unique_ptr<Stats[]> stats;
+	int scopeNum;
+	int depth;
+	long long frameNum;
+
+	std::unique_ptr<Event[]> events;
+	int eventCapacity;
+	int eventNum;
+	long long droppedEvents;
+
+	GpuQuery gpuQueries[GPU_FRAMES][GPU_QUERIES_PER_FRAME];
+	int gpuQueryNum[GPU_FRAMES];
+	int gpuFrame;
+	bool gpuActive;
+	long long gpuLate;    // results not available after GPU_FRAMES frames
+	long long gpuSkipped; // nested or over the per-frame budget
+
+	int frameScope;
+	long long frameStart;
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+public:
+	/* enabled: a disabled profiler ignores every scope and creates no GL object
+	 * eventCapacity: measurements kept for the trace, the following ones only update statistics
+	 * A GL context must be current when enabled.
+	 */
+	explicit Profiler(bool enabled, int eventCapacity = 1 << 18) :
+		enabled(enabled), stats(new Stats[MAX_SCOPES]), scopeNum(0), depth(0), frameNum(0),
+		events(enabled ? new Event[eventCapacity] : nullptr), eventCapacity(enabled ? eventCapacity : 0),
+		eventNum(0), droppedEvents(0), gpuFrame(0), gpuActive(false), gpuLate(0), gpuSkipped(0),
+		frameScope(-1), frameStart(0)
+	{
+		for (int f = 0; f < GPU_FRAMES; ++f) {
+			gpuQueryNum[f] = 0;
+			for (int q = 0; q < GPU_QUERIES_PER_FRAME; ++q) {
+				gpuQueries[f][q].query = 0;
+				if (enabled) {
+					glGenQueries(1, &gpuQueries[f][q].query);
+				}
+			}
+		}
+	}
+
+	~Profiler()
+	{
+		for (int f = 0; f < GPU_FRAMES; ++f) {
+			for (int q = 0; q < GPU_QUERIES_PER_FRAME; ++q) {
+				if (gpuQueries[f][q].query != 0) {
+					glDeleteQueries(1, &gpuQueries[f][q].query);
+				}
+			}
+		}
+	}
+
+	bool Enabled() const { return enabled; }
+	long long FrameNum() const { return frameNum; }
+
+	// nanoseconds since the profiler was created
+	long long Now() { return clock.duration<std::chrono::nanoseconds>().count(); }
+
+	// Start a frame, collects the GPU results of GPU_FRAMES frames ago
+	void BeginFrame()
+	{
+		if (!enabled) {
+			return;
+		}
+		gpuFrame = (gpuFrame + 1) % GPU_FRAMES;
+		CollectGpu(gpuFrame, false);
+		frameScope = Scope("Frame", false);
+		frameStart = Now();
+		++depth;
+	}
+
+	void EndFrame()
+	{
+		if (!enabled || frameScope < 0) {
+			return;
+		}
+		--depth;
+		Record(frameScope, frameStart, Now() - frameStart);
+		++frameNum;
+	}
+
+	// Wait for every GPU query still in flight, at shutdown before reading the results
+	void Flush()
+	{
+		if (!enabled) {
+			return;
+		}
+		for (int i = 1; i <= GPU_FRAMES; ++i) {
+			CollectGpu((gpuFrame + i) % GPU_FRAMES, true);
+		}
+	}
+
+	// Index of a scope, created on first use
+	int Scope(const char* name, bool gpu)
+	{
+		for (int i = 0; i < scopeNum; ++i) {
+			if (stats[i].gpu == gpu && (stats[i].name == name || std::strcmp(stats[i].name, name) == 0)) {
+				return i;
+			}
+		}
+		if (scopeNum == MAX_SCOPES) {
+			return -1;
+		}
+		Stats& s = stats[scopeNum];
+		s.name = name;
+		s.gpu = gpu;
+		s.depth = depth;
+		s.count = 0;
+		s.minNs = 0;
+		s.maxNs = 0;
+		s.sumNs = 0.0;
+		std::fill(s.buckets, s.buckets + BUCKET_NUM, 0u);
+		return scopeNum++;
+	}
+
+	// CpuScope internals
+	int BeginCpu(const char* name)
+	{
+		if (!enabled) {
+			return -1;
+		}
+		const int scope = Scope(name, false);
+		++depth;
+		return scope;
+	}
+
+	void EndCpu(int scope, long long startNs)
+	{
+		if (!enabled) {
+			return;
+		}
+		--depth;
+		if (scope >= 0) {
+			Record(scope, startNs, Now() - startNs);
+		}
+	}
+
+	// GpuScope internals, returns whether a query was started
+	bool BeginGpu(const char* name)
+	{
+		if (!enabled) {
+			return false;
+		}
+		const int scope = Scope(name, true);
+		int& num = gpuQueryNum[gpuFrame];
+		if (gpuActive || num == GPU_QUERIES_PER_FRAME || scope < 0) {
+			++gpuSkipped;
+			return false;
+		}
+		GpuQuery& q = gpuQueries[gpuFrame][num++];
+		q.scope = scope;
+		q.submitNs = Now();
+		glBeginQuery(GL_TIME_ELAPSED, q.query);
+		gpuActive = true;
+		return true;
+	}
+
+	void EndGpu()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuActive = false;
+	}
+
+	// min / avg / p99 / max of every scope, in milliseconds
+	void Print(std::ostream& out) const
+	{
+		if (!enabled) {
+			return;
+		}
+		// the caller's stream, its format is restored at the end
+		const std::ios_base::fmtflags flags = out.flags();
+		const std::streamsize precision = out.precision();
+		out << "Profile of " << frameNum << " frames (ms)" << std::endl;
+		out << std::left << std::setw(28) << "  scope" << std::right
+			<< std::setw(10) << "count" << std::setw(10) << "min" << std::setw(10) << "avg"
+			<< std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+		for (int i = 0; i < scopeNum; ++i) {
+			const Stats& s = stats[i];
+			const std::string name = std::string(2 + 2 * s.depth, ' ') + s.name + (s.gpu ? " [GPU]" : "");
+			out << std::left << std::setw(28) << name << std::right << std::setw(10) << s.count
+				<< std::fixed << std::setprecision(3)
+				<< std::setw(10) << s.minNs * 1e-6
+				<< std::setw(10) << (s.count > 0 ? s.sumNs / s.count * 1e-6 : 0.0)
+				<< std::setw(10) << Percentile(s, 0.99) * 1e-6
+				<< std::setw(10) << s.maxNs * 1e-6 << std::endl;
+		}
+		if (droppedEvents > 0 || gpuLate > 0 || gpuSkipped > 0) {
+			out << "  " << droppedEvents << " events over the trace capacity, " << gpuLate
+				<< " late GPU queries, " << gpuSkipped << " skipped GPU scopes" << std::endl;
+		}
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	// Write every kept measurement as a Chrome trace, CPU & GPU scopes on two tracks
+	bool WriteChromeTrace(const std::string& filename) const
+	{
+		if (!enabled) {
+			return false;
+		}
+		std::ofstream fout(filename);
+		if (!fout) {
+			std::cerr << "Profiler: cannot write trace file '" << filename << "'" << std::endl;
+			return false;
+		}
+		fout << "{\"traceEvents\":[\n";
+		fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+		fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+		fout << std::fixed << std::setprecision(3);
+		for (int i = 0; i < eventNum; ++i) {
+			const Event& e = events[i];
+			const Stats& s = stats[e.scope];
+			fout << ",\n{\"name\":\"" << s.name << "\",\"cat\":\"" << (s.gpu ? "gpu" : "cpu")
+				 << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (s.gpu ? 2 : 1)
+				 << ",\"ts\":" << e.startNs * 1e-3 << ",\"dur\":" << e.durationNs * 1e-3 << "}";
+		}
+		fout << "\n]}\n";
+		return bool(fout);
+	}
+
+private:
+	void Record(int scope, long long startNs, long long durationNs)
+	{
+		Stats& s = stats[scope];
+		if (s.count == 0 || durationNs < s.minNs) {
+			s.minNs = durationNs;
+		}
+		if (durationNs > s.maxNs) {
+			s.maxNs = durationNs;
+		}
+		++s.count;
+		s.sumNs += double(durationNs);
+		++s.buckets[Bucket(durationNs)];
+
+		if (eventNum < eventCapacity) {
+			events[eventNum++] = Event{ scope, startNs, durationNs };
+		} else {
+			++droppedEvents;
+		}
+	}
+
+	void CollectGpu(int frame, bool wait)
+	{
+		for (int i = 0; i < gpuQueryNum[frame]; ++i) {
+			const GpuQuery& q = gpuQueries[frame][i];
+			GLint available = 0;
+			glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == 0 && !wait) {
+				++gpuLate;
+				continue;
+			}
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &elapsed);
+			Record(q.scope, q.submitNs, (long long)elapsed);
+		}
+		gpuQueryNum[frame] = 0;
+	}
+
+	// bucket of a duration, BUCKETS_PER_OCTAVE linear steps between powers of two
+	static int Bucket(long long ns)
+	{
+		if (ns < 1) {
+			return 0;
+		}
+		int exponent;
+		const double mantissa = std::frexp(double(ns), &exponent); // ns = mantissa * 2^exponent, mantissa in [0.5, 1)
+		const int bucket = (exponent - 1) * BUCKETS_PER_OCTAVE + int((2.0 * mantissa - 1.0) * BUCKETS_PER_OCTAVE);
+		return bucket < BUCKET_NUM ? bucket : BUCKET_NUM - 1;
+	}
+
+	// upper bound of a bucket, in nanoseconds
+	static double BucketLimit(int bucket)
+	{
+		const int octave = bucket / BUCKETS_PER_OCTAVE;
+		const int step = bucket % BUCKETS_PER_OCTAVE;
+		return std::ldexp(1.0 + double(step + 1) / BUCKETS_PER_OCTAVE, octave);
+	}
+
+	static double Percentile(const Stats& s, double p)
+	{
+		if (s.count == 0) {
+			return 0.0;
+		}
+		const long long rank = (long long)std::ceil(p * double(s.count));
+		long long seen = 0;
+		for (int b = 0; b < BUCKET_NUM; ++b) {
+			seen += s.buckets[b];
+			if (seen >= rank) {
+				return std::min(std::max(BucketLimit(b), double(s.minNs)), double(s.maxNs));
+			}
+		}
+		return double(s.maxNs);
+	}
+};
+
+// Time the CPU work of the enclosing block
+class CpuScope
+{
+	Profiler& profiler;
+	int scope;
+	long long start;
+
+	CpuScope(const CpuScope&) = delete;
+	CpuScope& operator=(const CpuScope&) = delete;
+
+public:
+	CpuScope(Profiler& profiler, const char* name) :
+		profiler(profiler), scope(profiler.BeginCpu(name)), start(profiler.Enabled() ? profiler.Now() : 0)
+	{
+	}
+
+	~CpuScope() { profiler.EndCpu(scope, start); }
+};
+
+// Time the GPU work of the GL commands issued in the enclosing block
+class GpuScope
+{
+	Profiler& profiler;
+	bool active;
+
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+
+public:
+	GpuScope(Profiler& profiler, const char* name) : profiler(profiler), active(profiler.BeginGpu(name)) {}
+
+	~GpuScope()
+	{
+		if (active) {
+			profiler.EndGpu();
+		}
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_PROFILER_H_ */
@@ -0,0 +1,167 @@
+#ifndef CG_PROGRAMCACHE_H_
+#define CG_PROGRAMCACHE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <glad/glad.h>
+
+namespace cg
+{
+
+/* On-disk cache of linked program binaries (GL 4.1 / ARB_get_program_binary).
+ * A binary is stored under a hash of everything it depends on: the sources of every
+ * stage and the driver's vendor, renderer & version strings, so editing a shader or
+ * updating the driver misses the cache instead of loading a stale program. The driver
+ * may still reject a binary, then the caller compiles from source as without the cache.
+ * Files go to DIRECTORY, relative to the working directory.
+ */
+class ProgramCache
+{
+	static constexpr const char* DIRECTORY = "shadercache";
+	static constexpr uint32_t MAGIC = 0x42504743; // "CGPB"
+
+public:
+	// Hash of the parts a program is built from (stage names, sources...) and of the driver
+	static uint64_t Key(const std::vector<std::string>& parts)
+	{
+		uint64_t hash = 14695981039346656037ull; // FNV-1a
+		const auto add = [&hash](const char* data, size_t size) {
+			// the size first, so ("ab", "c") and ("a", "bc") differ
+			for (int i = 0; i < 8; ++i) {
+				hash = (hash ^ ((uint64_t(size) >> (8 * i)) & 0xFF)) * 1099511628211ull;
+			}
+			for (size_t i = 0; i < size; ++i) {
+				hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+			}
+		};
+		for (const std::string& part : parts) {
+			add(part.data(), part.size());
+		}
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+			const char* driver = reinterpret_cast<const char*>(glGetString(name));
+			add(driver != nullptr ? driver : "", driver != nullptr ? strlen(driver) : 0);
+		}
+		return hash;
+	}
+
+	static bool Supported()
+	{
+		if (!GLAD_GL_VERSION_4_1) {
+			return false;
+		}
+		GLint formatNum = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatNum);
+		return formatNum > 0;
+	}
+
+	/* A program created from the binary cached under key.
+	 * Returns 0 when there is none or the driver rejects it.
+	 */
+	static GLuint Load(uint64_t key)
+	{
+		if (!Supported()) {
+			return 0;
+		}
+		std::ifstream fin(Path(key), std::ios::in | std::ios::binary);
+		if (!fin) {
+			return 0;
+		}
+		uint32_t magic = 0;
+		uint32_t format = 0;
+		uint32_t length = 0;
+		uint64_t storedKey = 0;
+		fin.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		fin.read(reinterpret_cast<char*>(&format), sizeof(format));
+		fin.read(reinterpret_cast<char*>(&length), sizeof(length));
+		fin.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+		if (!fin || magic != MAGIC || storedKey != key || length == 0) {
+			return 0;
+		}
+		std::vector<char> binary(length);
+		fin.read(binary.data(), length);
+		if (!fin) {
+			return 0;
+		}
+
+		const GLuint program = glCreateProgram();
+		glProgramBinary(program, GLenum(format), binary.data(), GLsizei(length));
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	// Before linking a program to Store(): ask the driver to keep its binary
+	static void Prepare(GLuint program)
+	{
+		if (Supported()) {
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+	}
+
+	// Save the binary of a linked program under key
+	static void Store(uint64_t key, GLuint program)
+	{
+		if (!Supported()) {
+			return;
+		}
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		GLsizei written = 0;
+		glGetProgramBinary(program, length, &written, &format, binary.data());
+		if (written <= 0) {
+			return;
+		}
+
+#ifdef _WIN32
+		_mkdir(DIRECTORY);
+#else
+		mkdir(DIRECTORY, 0755);
+#endif
+		std::ofstream fout(Path(key), std::ios::out | std::ios::binary | std::ios::trunc);
+		const uint32_t magic = MAGIC;
+		const uint32_t binaryFormat = format;
+		const uint32_t binaryLength = uint32_t(written);
+		fout.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+		fout.write(reinterpret_cast<const char*>(&binaryFormat), sizeof(binaryFormat));
+		fout.write(reinterpret_cast<const char*>(&binaryLength), sizeof(binaryLength));
+		fout.write(reinterpret_cast<const char*>(&key), sizeof(key));
+		fout.write(binary.data(), written);
+		if (!fout) {
+			std::cerr << "ProgramCache: cannot write '" << Path(key) << "'" << std::endl;
+		}
+	}
+
+private:
+	static std::string Path(uint64_t key)
+	{
+		std::ostringstream path;
+		path << DIRECTORY << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+		return path.str();
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_PROGRAMCACHE_H_ */
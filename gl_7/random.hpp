@@ -0,0 +1,210 @@
+#ifndef CG_RANDOM_H_
+#define CG_RANDOM_H_
+
+#include <cstdint>
+#include <random>
+
+namespace cg
+{
+
+/* Fast, deterministic random numbers for particle systems.
+ * Generators are xoshiro128** streams. Each stream is derived from a global seed and
+ * a stream id, so every system can own its generator (no shared state, safe to use
+ * from any thread) and a run can be replayed bit for bit with SetSeed().
+ */
+class Random
+{
+	std::uint32_t s[4];
+
+public:
+	// Use a fixed global seed, every stream created afterwards is reproducible
+	static void SetSeed(std::uint64_t seed)
+	{
+		GlobalSeed() = seed;
+	}
+
+	// Generator of stream id under the global seed
+	static Random Stream(std::uint64_t id)
+	{
+		return Random(GlobalSeed(), id);
+	}
+
+	Random(std::uint64_t seed, std::uint64_t id)
+	{
+		std::uint64_t state = StreamState(seed, id);
+		Seed(s, state);
+	}
+
+	std::uint32_t Next()
+	{
+		return Step(s[0], s[1], s[2], s[3]);
+	}
+
+	// uniform in [0, 1)
+	float NextFloat() { return ToFloat(Next()); }
+
+	// uniform in [lo, hi)
+	float NextFloat(float lo, float hi) { return lo + (hi - lo) * NextFloat(); }
+
+	// uniform in [0, n)
+	int NextInt(int n) { return int((std::uint64_t(Next()) * std::uint32_t(n)) >> 32); }
+
+	static std::uint64_t& GlobalSeed()
+	{
+		// a fresh seed per run unless SetSeed() is called
+		static std::uint64_t seed = (std::uint64_t(std::random_device()()) << 32) ^ std::random_device()();
+		return seed;
+	}
+
+	static std::uint64_t SplitMix(std::uint64_t& state)
+	{
+		std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	static std::uint64_t StreamState(std::uint64_t seed, std::uint64_t id)
+	{
+		std::uint64_t mixed = id;
+		return seed ^ SplitMix(mixed);
+	}
+
+	// fill a xoshiro state from a splitmix sequence, never all zero
+	static void Seed(std::uint32_t (&state)[4], std::uint64_t& splitMix)
+	{
+		const std::uint64_t a = SplitMix(splitMix);
+		const std::uint64_t b = SplitMix(splitMix);
+		state[0] = std::uint32_t(a);
+		state[1] = std::uint32_t(a >> 32);
+		state[2] = std::uint32_t(b);
+		state[3] = std::uint32_t(b >> 32) | 1u;
+	}
+
+	static float ToFloat(std::uint32_t x)
+	{
+		return float(x >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// one xoshiro128** step, multiplications written as shifts so lanes vectorize on plain SSE2
+	static std::uint32_t Step(std::uint32_t& s0, std::uint32_t& s1, std::uint32_t& s2, std::uint32_t& s3)
+	{
+		const std::uint32_t x = s1 + (s1 << 2); // s1 * 5
+		const std::uint32_t r = (x << 7) | (x >> 25); // rotl(x, 7)
+		const std::uint32_t result = r + (r << 3); // r * 9
+		const std::uint32_t t = s1 << 9;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = (s3 << 11) | (s3 >> 21); // rotl(s3, 11)
+		return result;
+	}
+};
+
+/* Batch generator: LANES independent xoshiro128** lanes kept as structure of arrays,
+ * advanced together so the compiler turns every step into a few vector instructions.
+ * Used to fill whole particle arrays (directions, colors, fade speeds) at once.
+ */
+class RandomBatch
+{
+public:
+	static constexpr int LANES = 8;
+
+private:
+	std::uint32_t s0[LANES], s1[LANES], s2[LANES], s3[LANES];
+	std::uint32_t buffer[LANES]; // values of the last step not handed out yet
+	int buffered;
+
+public:
+	static RandomBatch Stream(std::uint64_t id)
+	{
+		return RandomBatch(Random::GlobalSeed(), id);
+	}
+
+	RandomBatch(std::uint64_t seed, std::uint64_t id) : buffered(0)
+	{
+		std::uint64_t state = Random::StreamState(seed, id);
+		for (int l = 0; l < LANES; ++l) {
+			std::uint32_t lane[4];
+			Random::Seed(lane, state);
+			s0[l] = lane[0];
+			s1[l] = lane[1];
+			s2[l] = lane[2];
+			s3[l] = lane[3];
+		}
+	}
+
+	// out[0, n) = raw 32-bit values
+	void FillBits(std::uint32_t* out, int n)
+	{
+		int i = 0;
+		while (buffered > 0 && i < n) {
+			out[i++] = buffer[LANES - buffered--];
+		}
+		for (; i + LANES <= n; i += LANES) {
+			StepLanes(out + i);
+		}
+		if (i < n) {
+			StepLanes(buffer);
+			buffered = LANES;
+			while (i < n) {
+				out[i++] = buffer[LANES - buffered--];
+			}
+		}
+	}
+
+	// out[0, n) uniform in [lo, hi), the same values as FillBits() converted
+	void Fill(float* out, int n, float lo = 0.0f, float hi = 1.0f)
+	{
+		const float scale = (hi - lo) * (1.0f / 16777216.0f);
+		int i = 0;
+		while (buffered > 0 && i < n) {
+			out[i++] = lo + float(buffer[LANES - buffered--] >> 8) * scale;
+		}
+		if (i + LANES <= n) {
+			// step & convert all lanes in one loop, a block is a few vector instructions;
+			// the lanes are copied to locals, which out cannot alias
+			std::uint32_t a[LANES], b[LANES], c[LANES], d[LANES];
+			for (int l = 0; l < LANES; ++l) {
+				a[l] = s0[l]; b[l] = s1[l]; c[l] = s2[l]; d[l] = s3[l];
+			}
+			for (; i + LANES <= n; i += LANES) {
+				float* block = out + i;
+				for (int l = 0; l < LANES; ++l) {
+					block[l] = lo + float(Random::Step(a[l], b[l], c[l], d[l]) >> 8) * scale;
+				}
+			}
+			for (int l = 0; l < LANES; ++l) {
+				s0[l] = a[l]; s1[l] = b[l]; s2[l] = c[l]; s3[l] = d[l];
+			}
+		}
+		if (i < n) {
+			StepLanes(buffer);
+			buffered = LANES;
+			while (i < n) {
+				out[i++] = lo + float(buffer[LANES - buffered--] >> 8) * scale;
+			}
+		}
+	}
+
+	float NextFloat(float lo = 0.0f, float hi = 1.0f)
+	{
+		float value;
+		Fill(&value, 1, lo, hi);
+		return value;
+	}
+
+private:
+	void StepLanes(std::uint32_t* out)
+	{
+		for (int l = 0; l < LANES; ++l) {
+			out[l] = Random::Step(s0[l], s1[l], s2[l], s3[l]);
+		}
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_RANDOM_H_ */
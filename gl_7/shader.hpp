@@ -5,24 +5,70 @@
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 #include <glad/glad.h>
 
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "programcache.hpp"
+
 namespace cg
 {
 
+/* Name of a uniform, hashed (FNV-1a) at compile time when constexpr, or when the
+ * compiler folds the hash of a string literal, so setting a uniform by name costs
+ * a lookup in a small sorted table instead of a glGetUniformLocation() string search.
+ */
+class UniformName
+{
+	uint64_t hash;
+
+	static constexpr uint64_t Fnv1a(const char* name, size_t length)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < length; ++i) {
+			hash = (hash ^ static_cast<unsigned char>(name[i])) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+public:
+	// from a string literal
+	template <size_t N>
+	constexpr UniformName(const char (&name)[N]) : hash(Fnv1a(name, N - 1)) {}
+	explicit UniformName(const std::string& name) : hash(Fnv1a(name.data(), name.size())) {}
+
+	constexpr uint64_t Hash() const { return hash; }
+};
+
 class Shader
 {
 	const GLuint shaderProgram;
 
+	// an active uniform & the value last set to it
+	struct UniformSlot
+	{
+		uint64_t hash;
+		GLint location;
+		bool known;        // value holds what the program has
+		GLfloat value[16]; // up to a mat4, ints stored bitwise
+	};
+	std::vector<UniformSlot> uniforms; // sorted by hash
+
 	Shader() = delete;
 	Shader(const Shader&) = delete;
 	Shader(Shader&&) = delete;
 	Shader& operator=(const Shader&) = delete;
 	Shader& operator=(Shader&&) = delete;
 
-	explicit Shader(const GLuint& prog) : shaderProgram(prog) {}
-	explicit Shader(GLuint&& prog) : shaderProgram(prog) {}
+	explicit Shader(const GLuint& prog) : shaderProgram(prog) { LoadUniforms(); }
+	explicit Shader(GLuint&& prog) : shaderProgram(prog) { LoadUniforms(); }
 
 public:
 	virtual ~Shader() { glDeleteProgram(shaderProgram); }
@@ -31,15 +77,26 @@ public:
 	{
 		// Build and compile our shader programs
 
+		// a program built from the same sources before is loaded from the cache
+		std::string vertexSource, fragmentSource;
+		if (!ReadSource(vertexFilename, vertexSource) || !ReadSource(fragmentFilename, fragmentSource)) {
+			return nullptr;
+		}
+		const uint64_t cacheKey = ProgramCache::Key({ "vertex", vertexSource, "fragment", fragmentSource });
+		GLuint program = ProgramCache::Load(cacheKey);
+		if (program != 0) {
+			return std::unique_ptr<Shader>(new Shader(program));
+		}
+
 		// Vertex shaders
-		const GLuint vertexShader = CompileShader(vertexFilename, GL_VERTEX_SHADER);
+		const GLuint vertexShader = CompileShader(vertexFilename, vertexSource, GL_VERTEX_SHADER);
 		if (vertexShader == 0) {
 			std::cerr << "Cannot create Vertex Shader from file '" << vertexFilename << "'." << std::endl;
 			return nullptr;
 		}
 
 		// Fragment shaders
-		const GLuint fragmentShader = CompileShader(fragmentFilename, GL_FRAGMENT_SHADER);
+		const GLuint fragmentShader = CompileShader(fragmentFilename, fragmentSource, GL_FRAGMENT_SHADER);
 		if (fragmentShader == 0) {
 			std::cerr << "Cannot create Fragment Shader from file '" << fragmentFilename << "'." << std::endl;
 			glDeleteShader(vertexShader);
@@ -47,9 +104,10 @@ public:
 		}
 
 		// link shaders: including vertex & fragment shaders
-		const GLuint program = glCreateProgram();
+		program = glCreateProgram();
 		glAttachShader(program, vertexShader);
 		glAttachShader(program, fragmentShader);
+		ProgramCache::Prepare(program);
 		glLinkProgram(program);
 
 		// release input shaders
@@ -67,6 +125,58 @@ public:
 			glDeleteProgram(program);
 			return nullptr;
 		}
+		ProgramCache::Store(cacheKey, program);
+
+		return std::unique_ptr<Shader>(new Shader(program));
+	}
+
+	/* Vertex-only program whose outputs are captured by transform feedback,
+	 * varyings are written interleaved into one buffer in the given order.
+	 */
+	static std::unique_ptr<Shader> CreateTransformFeedback(const std::string& vertexFilename, const std::vector<const GLchar*>& varyings)
+	{
+		// a program built from the same sources before is loaded from the cache
+		std::string vertexSource;
+		if (!ReadSource(vertexFilename, vertexSource)) {
+			return nullptr;
+		}
+		std::vector<std::string> keyParts = { "vertex", vertexSource, "interleaved" };
+		keyParts.insert(keyParts.end(), varyings.begin(), varyings.end());
+		const uint64_t cacheKey = ProgramCache::Key(keyParts);
+		GLuint program = ProgramCache::Load(cacheKey);
+		if (program != 0) {
+			return std::unique_ptr<Shader>(new Shader(program));
+		}
+
+		// Vertex shaders
+		const GLuint vertexShader = CompileShader(vertexFilename, vertexSource, GL_VERTEX_SHADER);
+		if (vertexShader == 0) {
+			std::cerr << "Cannot create Vertex Shader from file '" << vertexFilename << "'." << std::endl;
+			return nullptr;
+		}
+
+		// captured outputs must be declared before linking
+		program = glCreateProgram();
+		glAttachShader(program, vertexShader);
+		glTransformFeedbackVaryings(program, GLsizei(varyings.size()), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+		ProgramCache::Prepare(program);
+		glLinkProgram(program);
+
+		// release input shader
+		glDeleteShader(vertexShader);
+
+		// check for linking errors
+		GLint success;
+		const GLsizei logLen = 512;
+		GLchar infoLog[logLen];
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			glGetProgramInfoLog(program, logLen, NULL, infoLog);
+			std::cerr << "Link Shader error: " << infoLog << std::endl;
+			glDeleteProgram(program);
+			return nullptr;
+		}
+		ProgramCache::Store(cacheKey, program);
 
 		return std::unique_ptr<Shader>(new Shader(program));
 	}
@@ -75,9 +185,128 @@ public:
 
 	void Use() const { glUseProgram(shaderProgram); }
 
+	// Handle of an active uniform, from Find(); -1 for a name the program does not use
+	struct Uniform
+	{
+		int index;
+	};
+
+	Uniform Find(UniformName name) const
+	{
+		const auto slot = std::lower_bound(uniforms.begin(), uniforms.end(), name.Hash(),
+			[](const UniformSlot& slot, uint64_t hash) { return slot.hash < hash; });
+		return Uniform{ slot != uniforms.end() && slot->hash == name.Hash() ? int(slot - uniforms.begin()) : -1 };
+	}
+
+	/* Set a uniform of this program, which must be in use.
+	 * The value set last is remembered and setting it again calls no glUniform*(), so
+	 * uniforms are to be set through this Shader only. Unknown uniforms are ignored like
+	 * location -1 is. Arrays are set by their name without "[0]", first element only.
+	 */
+	void Set(Uniform uniform, GLint value)
+	{
+		if (const UniformSlot* slot = Assign(uniform, &value, sizeof(value))) {
+			glUniform1i(slot->location, value);
+		}
+	}
+
+	void Set(Uniform uniform, GLfloat value)
+	{
+		if (const UniformSlot* slot = Assign(uniform, &value, sizeof(value))) {
+			glUniform1f(slot->location, value);
+		}
+	}
+
+	void Set(Uniform uniform, const glm::vec2& value)
+	{
+		if (const UniformSlot* slot = Assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniform2fv(slot->location, 1, glm::value_ptr(value));
+		}
+	}
+
+	void Set(Uniform uniform, const glm::vec3& value)
+	{
+		if (const UniformSlot* slot = Assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniform3fv(slot->location, 1, glm::value_ptr(value));
+		}
+	}
+
+	void Set(Uniform uniform, const glm::vec4& value)
+	{
+		if (const UniformSlot* slot = Assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniform4fv(slot->location, 1, glm::value_ptr(value));
+		}
+	}
+
+	void Set(Uniform uniform, const glm::mat3& value)
+	{
+		if (const UniformSlot* slot = Assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniformMatrix3fv(slot->location, 1, GL_FALSE, glm::value_ptr(value));
+		}
+	}
+
+	void Set(Uniform uniform, const glm::mat4& value)
+	{
+		if (const UniformSlot* slot = Assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniformMatrix4fv(slot->location, 1, GL_FALSE, glm::value_ptr(value));
+		}
+	}
+
+	template <typename T>
+	void Set(UniformName name, const T& value) { Set(Find(name), value); }
+
 private:
 
-	static const GLuint CompileShader(const std::string& filename, GLenum type)
+	// Build the uniform table from the active uniforms of the linked program
+	void LoadUniforms()
+	{
+		GLint uniformNum = 0;
+		GLint maxLength = 0;
+		glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &uniformNum);
+		glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> nameBuffer(std::max(maxLength, 1));
+		for (GLint i = 0; i < uniformNum; ++i) {
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(shaderProgram, GLuint(i), GLsizei(nameBuffer.size()), &length, &size, &type, nameBuffer.data());
+			const std::string name(nameBuffer.data(), length);
+			const GLint location = glGetUniformLocation(shaderProgram, name.c_str());
+			if (location < 0) {
+				continue; // member of a uniform block
+			}
+			// arrays are reported as "name[0]"
+			const bool array = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+			UniformSlot slot = {};
+			slot.hash = UniformName(array ? name.substr(0, name.size() - 3) : name).Hash();
+			slot.location = location;
+			uniforms.push_back(slot);
+		}
+		std::sort(uniforms.begin(), uniforms.end(), [](const UniformSlot& a, const UniformSlot& b) { return a.hash < b.hash; });
+		for (size_t i = 1; i < uniforms.size(); ++i) {
+			if (uniforms[i].hash == uniforms[i - 1].hash) {
+				std::cerr << "Shader: uniforms at locations " << uniforms[i - 1].location << " and " << uniforms[i].location << " have the same name hash" << std::endl;
+			}
+		}
+	}
+
+	// The slot to set to value, nullptr when it holds value already or is unknown
+	UniformSlot* Assign(Uniform uniform, const void* value, size_t size)
+	{
+		if (uniform.index < 0) {
+			return nullptr;
+		}
+		UniformSlot& slot = uniforms[uniform.index];
+		if (slot.known && memcmp(slot.value, value, size) == 0) {
+			return nullptr;
+		}
+		memcpy(slot.value, value, size);
+		slot.known = true;
+		return &slot;
+	}
+
+	// Read a whole shader file
+	static bool ReadSource(const std::string& filename, std::string& source)
 	{
 		std::ifstream fin;
 
@@ -88,7 +317,7 @@ private:
 		}
 		catch (const std::ifstream::failure& e) {
 			std::cerr << "Shader: open file '" << filename << "' error: " << e.what() << std::endl;
-			return 0;
+			return false;
 		}
 
 		// read all content from file
@@ -100,13 +329,18 @@ private:
 		catch (const std::ifstream::failure& e) {
 			std::cerr << "Shader: read file '" << filename << "' error: " << e.what() << std::endl;
 			fin.close();
-			return 0;
+			return false;
 		}
 
 		// finish reading
 		fin.close();
 
-		const std::string source = stream.str();
+		source = stream.str();
+		return true;
+	}
+
+	static const GLuint CompileShader(const std::string& filename, const std::string& source, GLenum type)
+	{
 		const GLchar* source_cstr = source.c_str();
 		const GLuint shader = glCreateShader(type);
 		glShaderSource(shader, 1, &source_cstr, NULL);
@@ -0,0 +1,151 @@
+#ifndef CG_UPLOADRING_H_
+#define CG_UPLOADRING_H_
+
+#include <iostream>
+
+#include <glad/glad.h>
+
+namespace cg
+{
+
+/* Triple-buffered ring for streaming vertex data to the GPU.
+ * The buffer is split into one region per frame in flight. Every frame allocates
+ * linearly from its own region, and a fence placed at the end of the frame guards
+ * the region until the GPU has consumed it, so writes never stall on an implicit
+ * sync and the buffer is never reallocated.
+ *
+ * With GL 4.4 (ARB_buffer_storage) the whole buffer is mapped once, persistently
+ * and coherently. Otherwise every allocation is mapped with GL_MAP_UNSYNCHRONIZED_BIT,
+ * which the fences make safe, and must be unmapped before the data is drawn.
+ */
+class UploadRing
+{
+public:
+	static constexpr int FRAME_NUM = 3;
+
+private:
+	GLenum target;
+	GLuint buffer;
+	GLsizeiptr frameSize;
+	GLsizeiptr head;     // next free byte of the current region
+	GLsizeiptr frameEnd; // end of the current region
+	int frame;
+	GLsync fences[FRAME_NUM];
+
+	bool persistent;
+	char* mapped;  // whole buffer, persistent path only
+	bool isMapped; // an allocation is mapped, fallback path only
+
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+public:
+	// frameSize: bytes available to one frame, rounded up so every region starts 256-byte aligned
+	UploadRing(GLenum target, GLsizeiptr frameSize) :
+		target(target), buffer(0), frameSize((frameSize + 255) / 256 * 256), head(0), frameEnd(this->frameSize), frame(0),
+		persistent(GLAD_GL_VERSION_4_4 != 0), mapped(nullptr), isMapped(false)
+	{
+		for (int i = 0; i < FRAME_NUM; ++i) {
+			fences[i] = 0;
+		}
+
+		const GLsizeiptr totalSize = this->frameSize * FRAME_NUM;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+		if (persistent) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, totalSize, NULL, flags);
+			mapped = static_cast<char*>(glMapBufferRange(target, 0, totalSize, flags));
+			if (mapped == nullptr) {
+				std::cerr << "UploadRing: persistent mapping failed, falling back to unsynchronized mapping" << std::endl;
+				persistent = false;
+				glDeleteBuffers(1, &buffer);
+				glGenBuffers(1, &buffer);
+				glBindBuffer(target, buffer);
+			}
+		}
+		if (!persistent) {
+			glBufferData(target, totalSize, NULL, GL_STREAM_DRAW);
+		}
+		glBindBuffer(target, 0);
+	}
+
+	~UploadRing()
+	{
+		for (int i = 0; i < FRAME_NUM; ++i) {
+			if (fences[i] != 0) {
+				glDeleteSync(fences[i]);
+			}
+		}
+		if (persistent) {
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	GLuint Buffer() const { return buffer; }
+	GLsizeiptr FrameSize() const { return frameSize; }
+	bool Persistent() const { return persistent; }
+
+	// Move to the next region, waiting until the GPU has finished reading it
+	void BeginFrame()
+	{
+		frame = (frame + 1) % FRAME_NUM;
+		if (fences[frame] != 0) {
+			GLenum status = glClientWaitSync(fences[frame], 0, 0);
+			while (status == GL_TIMEOUT_EXPIRED) {
+				status = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			}
+			glDeleteSync(fences[frame]);
+			fences[frame] = 0;
+		}
+		head = frameSize * frame;
+		frameEnd = head + frameSize;
+	}
+
+	// Fence the current region after the last draw reading from it
+	void EndFrame()
+	{
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	/* Reserve size bytes of the current frame, offset receives their position in Buffer().
+	 * Returns nullptr when the frame has run out of space.
+	 * The memory must be released with Unmap() before drawing from it.
+	 */
+	void* Map(GLsizeiptr size, GLintptr& offset, GLsizeiptr alignment = 16)
+	{
+		const GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+		if (start + size > frameEnd) {
+			return nullptr;
+		}
+		head = start + size;
+		offset = start;
+
+		if (persistent) {
+			return mapped + start;
+		}
+		glBindBuffer(target, buffer);
+		void* data = glMapBufferRange(target, start, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		glBindBuffer(target, 0);
+		isMapped = data != nullptr;
+		return data;
+	}
+
+	// Make the last mapped allocation visible to the GPU
+	void Unmap()
+	{
+		if (isMapped) {
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+			isMapped = false;
+		}
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_UPLOADRING_H_ */
@@ -0,0 +1,10 @@
+// Cubic Bezier basis, shared by the tessellation evaluation shaders
+
+// The four Bernstein polynomials of degree 3 at t
+vec4 bernstein(float t)
+{
+	return vec4((1.-t) * (1.-t) * (1.-t),
+		3. * t * (1.-t) * (1.-t),
+		3. * t * t * (1.-t),
+		t * t * t);
+}
@@ -0,0 +1,184 @@
+#ifndef CG_FILEWATCHER_H_
+#define CG_FILEWATCHER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace cg
+{
+
+/* Reports the files of a set which were written since the last call to Changed().
+ * Files are kept & reported as Normalize() spells them, so "./a.glsl" and "a.glsl" are one.
+ * On Linux the directories of the files are watched with inotify: a change is a file
+ * closed after writing or renamed over, which catches editors saving through a temporary
+ * file too, and Changed() costs one non-blocking read. Elsewhere the modification times
+ * of the files are compared every POLL_INTERVAL.
+ */
+class FileWatcher
+{
+	std::vector<std::string> files;
+#ifdef __linux__
+	int inotifyFd;
+	std::vector<std::pair<int, std::string>> directories; // watch descriptor, path
+#else
+	static constexpr double POLL_INTERVAL = 0.25; // seconds
+	std::vector<time_t> modifiedTimes;
+	std::chrono::steady_clock::time_point lastPoll;
+#endif
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+public:
+#ifdef __linux__
+	FileWatcher() : inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+	{
+		if (inotifyFd < 0) {
+			std::cerr << "FileWatcher: cannot init inotify, files are not watched" << std::endl;
+		}
+	}
+
+	~FileWatcher()
+	{
+		if (inotifyFd >= 0) {
+			close(inotifyFd);
+		}
+	}
+#else
+	FileWatcher() : lastPoll(std::chrono::steady_clock::now()) {}
+#endif
+
+	void Add(const std::string& path)
+	{
+		const std::string file = Normalize(path);
+		if (std::find(files.begin(), files.end(), file) != files.end()) {
+			return;
+		}
+		files.push_back(file);
+#ifdef __linux__
+		const std::string directory = Directory(file);
+		const auto watched = std::find_if(directories.begin(), directories.end(),
+			[&directory](const std::pair<int, std::string>& entry) { return entry.second == directory; });
+		if (inotifyFd >= 0 && watched == directories.end()) {
+			const int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd < 0) {
+				std::cerr << "FileWatcher: cannot watch '" << directory << "'" << std::endl;
+				return;
+			}
+			directories.emplace_back(wd, directory);
+		}
+#else
+		modifiedTimes.push_back(ModifiedTime(file));
+#endif
+	}
+
+	/* One spelling of a relative or absolute path: "." components & repeated slashes
+	 * removed, "a/./b.glsl" and "./a//b.glsl" both give "a/b.glsl". ".." is kept as is.
+	 */
+	static std::string Normalize(const std::string& path)
+	{
+		std::string normalized = !path.empty() && path[0] == '/' ? "/" : "";
+		for (size_t start = 0; start <= path.size(); ) {
+			size_t end = path.find('/', start);
+			end = end == std::string::npos ? path.size() : end;
+			const std::string part = path.substr(start, end - start);
+			if (!part.empty() && part != ".") {
+				if (!normalized.empty() && normalized.back() != '/') {
+					normalized += '/';
+				}
+				normalized += part;
+			}
+			start = end + 1;
+		}
+		return normalized.empty() ? std::string(".") : normalized;
+	}
+
+	// The watched files written since the last call
+	std::vector<std::string> Changed()
+	{
+		std::vector<std::string> changed;
+#ifdef __linux__
+		if (inotifyFd < 0) {
+			return changed;
+		}
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+			for (ssize_t offset = 0; offset < length; ) {
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+				if (event->len == 0) {
+					continue;
+				}
+				// one directory added as two paths ("." & its absolute path) shares a descriptor
+				for (const std::pair<int, std::string>& directory : directories) {
+					if (directory.first != event->wd) {
+						continue;
+					}
+					const std::string file = Join(directory.second, event->name);
+					if (std::find(files.begin(), files.end(), file) != files.end() && std::find(changed.begin(), changed.end(), file) == changed.end()) {
+						changed.push_back(file);
+					}
+				}
+			}
+		}
+#else
+		const auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - lastPoll).count() < POLL_INTERVAL) {
+			return changed;
+		}
+		lastPoll = now;
+		for (size_t i = 0; i < files.size(); ++i) {
+			const time_t modified = ModifiedTime(files[i]);
+			if (modified != modifiedTimes[i]) {
+				modifiedTimes[i] = modified;
+				changed.push_back(files[i]);
+			}
+		}
+#endif
+		return changed;
+	}
+
+private:
+#ifdef __linux__
+	// The directory of a path as given, "." for a bare file name
+	static std::string Directory(const std::string& file)
+	{
+		const size_t slash = file.find_last_of('/');
+		return slash == std::string::npos ? std::string(".") : file.substr(0, std::max<size_t>(slash, 1));
+	}
+
+	// The path of name in directory, normalized as Add() stores it
+	static std::string Join(const std::string& directory, const char* name)
+	{
+		if (directory == ".") {
+			return name;
+		}
+		return directory == "/" ? "/" + std::string(name) : directory + "/" + name;
+	}
+#else
+	// 0 for a file which cannot be read
+	static time_t ModifiedTime(const std::string& file)
+	{
+		struct stat status;
+		return stat(file.c_str(), &status) == 0 ? status.st_mtime : 0;
+	}
+#endif
+};
+
+} /* namespace cg */
+
+#endif /* CG_FILEWATCHER_H_ */
@@ -11,6 +11,9 @@
 
 // Other includes
 #include "shader.hpp"
+#include "shaderreloader.hpp"
+#include "shadervariants.hpp"
+#include "benchmark.hpp"
 
 using namespace cg;
 
@@ -29,10 +32,13 @@ float lastFrame = 0.0f;
 float level = 5.0f;
 
 // The MAIN function, from here we start the application and run the game loop
-int main()
+int main(int argc, char* argv[])
 {
+    // Headless run of a fixed number of frames with --benchmark
+    Benchmark benchmark(argc, argv, "gl_8_1");
+
     // Init GLFW
-    glfwInit();
+    benchmark.Init();
     // Set all the required options for GLFW
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
@@ -55,10 +61,24 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    if (!benchmark.Attach(window)) {
+        return -1;
+    }
 
-    // Build and compile our shader program
-    auto ourShader = Shader::Create("main.vert.glsl", "main.frag.glsl", "main.tcs.glsl", "main.tes.glsl");
-    auto ourShader2 = Shader::Create("main.vert.glsl", "main.frag.glsl");
+    // Saved shader files are built again & swapped in while running
+    ShaderReloader shaderReloader;
+    // Build and compile our shader program: the tessellated curve & the control points, both at once
+    constexpr unsigned CURVE = ShaderVariants::TESSELLATION;
+    constexpr unsigned CONTROL_POINTS = 0;
+    ShaderVariants shaders("main.vert.glsl", "main.frag.glsl", "main.tcs.glsl", "main.tes.glsl", CURVE, &shaderReloader);
+    shaders.Prewarm(CURVE);
+    shaders.Prewarm(CONTROL_POINTS);
+    Shader* ourShader = shaders.Get(CURVE);
+    Shader* ourShader2 = shaders.Get(CONTROL_POINTS);
+    if (ourShader == nullptr || ourShader2 == nullptr) {
+        std::cerr << "Error creating Shader Program" << std::endl;
+        return -1;
+    }
 
     // Set up vertex data (and buffer(s)) and attribute pointers
     // 4 control points
@@ -84,16 +104,20 @@ int main()
     glBindVertexArray(0); // Unbind VAO
 
     // Game loop
-    while (!glfwWindowShouldClose(window))     {
-        float currentFrame = (float)glfwGetTime();
+    while (benchmark.Running(window))     {
+        benchmark.Phase("Events");
+        float currentFrame = (float)benchmark.Time();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         // Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
         glfwPollEvents();
+        benchmark.Phase("Update");
         change_scale();
+        shaderReloader.Update();
 
         // Render
+        benchmark.Phase("Draw");
         // Clear the colorbuffer
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -117,11 +141,12 @@ int main()
         glBindVertexArray(0);
 
         // Swap the screen buffers
-        glfwSwapBuffers(window);
+        benchmark.SwapBuffers(window);
     }
     // Properly de-allocate all resources once they've outlived their purpose
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
+    benchmark.Report();
     // Terminate GLFW, clearing any resources allocated by GLFW.
     glfwTerminate();
     return 0;
@@ -2,6 +2,8 @@
 
 layout(isolines, equal_spacing) in;
 
+#include "bezier.glsl"
+
 void main() {
 	vec4 p0 = gl_in[0].gl_Position;
 	vec4 p1 = gl_in[1].gl_Position;
@@ -9,9 +11,6 @@ void main() {
 	vec4 p3 = gl_in[3].gl_Position;
 	float u = gl_TessCoord.x;
 	// the basis functions:
-	float b0 = (1.-u) * (1.-u) * (1.-u);
-	float b1 = 3. * u * (1.-u) * (1.-u);
-	float b2 = 3. * u * u * (1.-u);
-	float b3 = u * u * u;
-	gl_Position = b0*p0 + b1*p1 + b2*p2 + b3*p3;
+	vec4 b = bernstein(u);
+	gl_Position = b.x*p0 + b.y*p1 + b.z*p2 + b.w*p3;
 }
\ No newline at end of file
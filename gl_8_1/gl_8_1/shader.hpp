@@ -2,18 +2,74 @@
 #define CG_SHADER_H_
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
 
 #include <glad/glad.h>
 
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "programcache.hpp"
+#include "shaderpreprocessor.hpp"
+
 namespace cg
 {
 
+/* Name of a uniform, hashed (FNV-1a) at compile time when constexpr, or when the
+ * compiler folds the hash of a string literal, so setting a uniform by name costs
+ * a lookup in a small sorted table instead of a glGetUniformLocation() string search.
+ */
+class UniformName
+{
+	uint64_t hash;
+
+	static constexpr uint64_t Fnv1a(const char* name, size_t length)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < length; ++i) {
+			hash = (hash ^ static_cast<unsigned char>(name[i])) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+public:
+	// from a string literal
+	template <size_t N>
+	constexpr UniformName(const char (&name)[N]) : hash(Fnv1a(name, N - 1)) {}
+	explicit UniformName(const std::string& name) : hash(Fnv1a(name.data(), name.size())) {}
+
+	constexpr uint64_t Hash() const { return hash; }
+};
+
+// A file a shader program is built from
+struct ShaderSource
+{
+	std::string filename;
+	GLenum type;
+};
+
 class Shader
 {
-	const GLuint shaderProgram;
+	GLuint shaderProgram;
+	std::vector<ShaderSource> sources;
+	std::vector<std::string> defines;
+	std::vector<std::string> files; // sources & their includes
+
+	// an active uniform & the value last set to it
+	struct UniformSlot
+	{
+		uint64_t hash;
+		GLint location;
+		bool known;        // value holds what the program has
+		GLfloat value[16]; // up to a mat4, ints stored bitwise
+	};
+	std::vector<UniformSlot> uniforms; // sorted by hash
 
 	Shader() = delete;
 	Shader(const Shader&) = delete;
@@ -21,8 +77,13 @@ class Shader
 	Shader& operator=(const Shader&) = delete;
 	Shader& operator=(Shader&&) = delete;
 
-	explicit Shader(const GLuint& prog) : shaderProgram(prog) {}
-	explicit Shader(GLuint&& prog) : shaderProgram(prog) {}
+	Shader(GLuint prog, const std::vector<ShaderSource>& sources, const std::vector<std::string>& defines, const std::vector<std::string>& files) :
+		shaderProgram(prog), sources(sources), defines(defines), files(files)
+	{
+		loadUniforms();
+	}
+
+	friend class ShaderBuild;
 
 public:
 	virtual ~Shader() { glDeleteProgram(shaderProgram); }
@@ -30,16 +91,32 @@ public:
 	static std::unique_ptr<Shader> Create(const char* const vertexFilename, const char* const fragmentFilename)
 	{
 		// Build and compile our shader programs
+		const std::vector<ShaderSource> sources = {
+			{ vertexFilename, GL_VERTEX_SHADER },
+			{ fragmentFilename, GL_FRAGMENT_SHADER }
+		};
+
+		// a program built from the same sources before is loaded from the cache
+		std::string vertexSource, fragmentSource;
+		std::vector<std::string> files;
+		if (!readSource(vertexFilename, {}, vertexSource, files) || !readSource(fragmentFilename, {}, fragmentSource, files)) {
+			return nullptr;
+		}
+		const uint64_t cacheKey = ProgramCache::Key({ "vertex", vertexSource, "fragment", fragmentSource });
+		GLuint program = ProgramCache::Load(cacheKey);
+		if (program != 0) {
+			return std::unique_ptr<Shader>(new Shader(program, sources, {}, files));
+		}
 
 		// Vertex shaders
-		const GLuint vertexShader = compileShader(vertexFilename, GL_VERTEX_SHADER);
+		const GLuint vertexShader = compileShader(vertexFilename, vertexSource, GL_VERTEX_SHADER);
 		if (vertexShader == 0) {
 			std::cerr << "Cannot create Vertex Shader from file '" << vertexFilename << "'." << std::endl;
 			return nullptr;
 		}
 
 		// Fragment shaders
-		const GLuint fragmentShader = compileShader(fragmentFilename, GL_FRAGMENT_SHADER);
+		const GLuint fragmentShader = compileShader(fragmentFilename, fragmentSource, GL_FRAGMENT_SHADER);
 		if (fragmentShader == 0) {
 			std::cerr << "Cannot create Fragment Shader from file '" << fragmentFilename << "'." << std::endl;
 			glDeleteShader(vertexShader);
@@ -47,9 +124,10 @@ public:
 		}
 
 		// link shaders: including vertex & fragment shaders
-		const GLuint program = glCreateProgram();
+		program = glCreateProgram();
 		glAttachShader(program, vertexShader);
 		glAttachShader(program, fragmentShader);
+		ProgramCache::Prepare(program);
 		glLinkProgram(program);
 
 		// release input shaders
@@ -67,23 +145,43 @@ public:
 			glDeleteProgram(program);
 			return nullptr;
 		}
+		ProgramCache::Store(cacheKey, program);
 
-		return std::unique_ptr<Shader>(new Shader(program));
+		return std::unique_ptr<Shader>(new Shader(program, sources, {}, files));
 	}
 
 	static std::unique_ptr<Shader> Create(const char* const vertexFilename, const char* const fragmentFilename, const char* const tcsFilename, const char* const tesFilename)
 	{
 		// Build and compile our shader programs
+		const std::vector<ShaderSource> sources = {
+			{ vertexFilename, GL_VERTEX_SHADER },
+			{ fragmentFilename, GL_FRAGMENT_SHADER },
+			{ tcsFilename, GL_TESS_CONTROL_SHADER },
+			{ tesFilename, GL_TESS_EVALUATION_SHADER }
+		};
+
+		// a program built from the same sources before is loaded from the cache
+		std::string vertexSource, fragmentSource, tcsSource, tesSource;
+		std::vector<std::string> files;
+		if (!readSource(vertexFilename, {}, vertexSource, files) || !readSource(fragmentFilename, {}, fragmentSource, files) ||
+			!readSource(tcsFilename, {}, tcsSource, files) || !readSource(tesFilename, {}, tesSource, files)) {
+			return nullptr;
+		}
+		const uint64_t cacheKey = ProgramCache::Key({ "vertex", vertexSource, "fragment", fragmentSource, "tcs", tcsSource, "tes", tesSource });
+		GLuint program = ProgramCache::Load(cacheKey);
+		if (program != 0) {
+			return std::unique_ptr<Shader>(new Shader(program, sources, {}, files));
+		}
 
 		// Vertex shaders
-		const GLuint vertexShader = compileShader(vertexFilename, GL_VERTEX_SHADER);
+		const GLuint vertexShader = compileShader(vertexFilename, vertexSource, GL_VERTEX_SHADER);
 		if (vertexShader == 0) {
 			std::cerr << "Cannot create Vertex Shader from file '" << vertexFilename << "'." << std::endl;
 			return nullptr;
 		}
 
 		// Fragment shaders
-		const GLuint fragmentShader = compileShader(fragmentFilename, GL_FRAGMENT_SHADER);
+		const GLuint fragmentShader = compileShader(fragmentFilename, fragmentSource, GL_FRAGMENT_SHADER);
 		if (fragmentShader == 0) {
 			std::cerr << "Cannot create Fragment Shader from file '" << fragmentFilename << "'." << std::endl;
 			glDeleteShader(vertexShader);
@@ -91,7 +189,7 @@ public:
 		}
 
 		// Tesselation control shaders
-		const GLuint tcsShader = compileShader(tcsFilename, GL_TESS_CONTROL_SHADER);
+		const GLuint tcsShader = compileShader(tcsFilename, tcsSource, GL_TESS_CONTROL_SHADER);
 		if (tcsShader == 0) {
 			std::cerr << "Cannot create Tesselation control Shader from file '" << tcsFilename << "'." << std::endl;
 			glDeleteShader(vertexShader);
@@ -100,7 +198,7 @@ public:
 		}
 
 		// Tesselation evaluation shaders
-		const GLuint tesShader = compileShader(tesFilename, GL_TESS_EVALUATION_SHADER);
+		const GLuint tesShader = compileShader(tesFilename, tesSource, GL_TESS_EVALUATION_SHADER);
 		if (tesShader == 0) {
 			std::cerr << "Cannot create Tesselation evaluation Shader from file '" << tesFilename << "'." << std::endl;
 			glDeleteShader(vertexShader);
@@ -110,11 +208,12 @@ public:
 		}
 
 		// link shaders: including vertex & fragment shaders
-		const GLuint program = glCreateProgram();
+		program = glCreateProgram();
 		glAttachShader(program, vertexShader);
 		glAttachShader(program, fragmentShader);
 		glAttachShader(program, tcsShader);
 		glAttachShader(program, tesShader);
+		ProgramCache::Prepare(program);
 		glLinkProgram(program);
 
 		// release input shaders
@@ -134,46 +233,187 @@ public:
 			glDeleteProgram(program);
 			return nullptr;
 		}
+		ProgramCache::Store(cacheKey, program);
 
-		return std::unique_ptr<Shader>(new Shader(program));
+		return std::unique_ptr<Shader>(new Shader(program, sources, {}, files));
 	}
 
 	const GLuint Program() const { return shaderProgram; }
 
+	// The files the program was built from
+	const std::vector<ShaderSource>& Sources() const { return sources; }
+
+	// The defines added to every stage
+	const std::vector<std::string>& Defines() const { return defines; }
+
+	// Every file read to build the program, the sources & the files they include
+	const std::vector<std::string>& Files() const { return files; }
+
 	void Use() const { glUseProgram(shaderProgram); }
 
-private:
+	/* Exchange programs with other, a rebuild of the same files.
+	 * Handles from Find() stay usable, a uniform the new program lost is ignored. Nothing is
+	 * known of the values of the program taken over, the next Set() of each uniform sets it.
+	 */
+	void Swap(Shader& other)
+	{
+		std::swap(shaderProgram, other.shaderProgram);
+		uniforms.swap(other.uniforms);
+		files.swap(other.files);
+	}
 
-	static const GLuint compileShader(const char* const filename, GLenum type)
+	/* Handle of a uniform, from Find(); index -1 for a name the program does not use.
+	 * The hash finds the uniform again when a Swap() moved or removed it.
+	 */
+	struct Uniform
 	{
-		std::ifstream fin;
+		int index;
+		uint64_t hash;
+	};
 
-		// ensures ifstream objects can throw exceptions:
-		fin.exceptions(std::ifstream::badbit);
-		try {
-			fin.open(filename, std::ios::in);
+	Uniform Find(UniformName name) const
+	{
+		return Uniform{ indexOf(name.Hash()), name.Hash() };
+	}
+
+	/* Set a uniform of this program, which must be in use.
+	 * The value set last is remembered and setting it again calls no glUniform*(), so
+	 * uniforms are to be set through this Shader only. Unknown uniforms are ignored like
+	 * location -1 is. Arrays are set by their name without "[0]", first element only.
+	 */
+	void Set(Uniform uniform, GLint value)
+	{
+		if (const UniformSlot* slot = assign(uniform, &value, sizeof(value))) {
+			glUniform1i(slot->location, value);
 		}
-		catch (const std::ifstream::failure& e) {
-			std::cerr << "Shader: open file '" << filename << "' error: " << e.what() << std::endl;
-			return 0;
+	}
+
+	void Set(Uniform uniform, GLfloat value)
+	{
+		if (const UniformSlot* slot = assign(uniform, &value, sizeof(value))) {
+			glUniform1f(slot->location, value);
 		}
+	}
 
-		// read all content from file
-		std::ostringstream stream;
-		fin.exceptions(std::ifstream::badbit);
-		try {
-			stream << fin.rdbuf();
+	void Set(Uniform uniform, const glm::vec2& value)
+	{
+		if (const UniformSlot* slot = assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniform2fv(slot->location, 1, glm::value_ptr(value));
 		}
-		catch (const std::ifstream::failure& e) {
-			std::cerr << "Shader: read file '" << filename << "' error: " << e.what() << std::endl;
-			fin.close();
-			return 0;
+	}
+
+	void Set(Uniform uniform, const glm::vec3& value)
+	{
+		if (const UniformSlot* slot = assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniform3fv(slot->location, 1, glm::value_ptr(value));
+		}
+	}
+
+	void Set(Uniform uniform, const glm::vec4& value)
+	{
+		if (const UniformSlot* slot = assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniform4fv(slot->location, 1, glm::value_ptr(value));
+		}
+	}
+
+	void Set(Uniform uniform, const glm::mat3& value)
+	{
+		if (const UniformSlot* slot = assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniformMatrix3fv(slot->location, 1, GL_FALSE, glm::value_ptr(value));
+		}
+	}
+
+	void Set(Uniform uniform, const glm::mat4& value)
+	{
+		if (const UniformSlot* slot = assign(uniform, glm::value_ptr(value), sizeof(value))) {
+			glUniformMatrix4fv(slot->location, 1, GL_FALSE, glm::value_ptr(value));
+		}
+	}
+
+	template <typename T>
+	void Set(UniformName name, const T& value) { Set(Find(name), value); }
+
+private:
+
+	// Build the uniform table from the active uniforms of the linked program
+	void loadUniforms()
+	{
+		GLint uniformNum = 0;
+		GLint maxLength = 0;
+		glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &uniformNum);
+		glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> nameBuffer(std::max(maxLength, 1));
+		for (GLint i = 0; i < uniformNum; ++i) {
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(shaderProgram, GLuint(i), GLsizei(nameBuffer.size()), &length, &size, &type, nameBuffer.data());
+			const std::string name(nameBuffer.data(), length);
+			const GLint location = glGetUniformLocation(shaderProgram, name.c_str());
+			if (location < 0) {
+				continue; // member of a uniform block
+			}
+			// arrays are reported as "name[0]"
+			const bool array = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+			UniformSlot slot = {};
+			slot.hash = UniformName(array ? name.substr(0, name.size() - 3) : name).Hash();
+			slot.location = location;
+			uniforms.push_back(slot);
+		}
+		std::sort(uniforms.begin(), uniforms.end(), [](const UniformSlot& a, const UniformSlot& b) { return a.hash < b.hash; });
+		for (size_t i = 1; i < uniforms.size(); ++i) {
+			if (uniforms[i].hash == uniforms[i - 1].hash) {
+				std::cerr << "Shader: uniforms at locations " << uniforms[i - 1].location << " and " << uniforms[i].location << " have the same name hash" << std::endl;
+			}
+		}
+	}
+
+	// Index of the uniform with hash in the table, -1 if the program does not use it
+	int indexOf(uint64_t hash) const
+	{
+		const auto slot = std::lower_bound(uniforms.begin(), uniforms.end(), hash,
+			[](const UniformSlot& slot, uint64_t key) { return slot.hash < key; });
+		return slot != uniforms.end() && slot->hash == hash ? int(slot - uniforms.begin()) : -1;
+	}
+
+	// The slot to set to value, nullptr when it holds value already or is unknown
+	UniformSlot* assign(Uniform uniform, const void* value, size_t size)
+	{
+		int index = uniform.index;
+		if (index < 0 || size_t(index) >= uniforms.size() || uniforms[index].hash != uniform.hash) {
+			index = indexOf(uniform.hash); // a handle from before a Swap()
+			if (index < 0) {
+				return nullptr;
+			}
 		}
+		UniformSlot& slot = uniforms[index];
+		if (slot.known && memcmp(slot.value, value, size) == 0) {
+			return nullptr;
+		}
+		memcpy(slot.value, value, size);
+		slot.known = true;
+		return &slot;
+	}
 
-		// finish reading
-		fin.close();
+	/* Read a shader file, #includes resolved & defines added by the ShaderPreprocessor.
+	 * The files read are appended to files.
+	 */
+	static bool readSource(const std::string& filename, const std::vector<std::string>& defines, std::string& source, std::vector<std::string>& files)
+	{
+		std::vector<std::string> read;
+		if (!ShaderPreprocessor::Process(filename, defines, source, &read)) {
+			return false;
+		}
+		for (const std::string& file : read) {
+			if (std::find(files.begin(), files.end(), file) == files.end()) {
+				files.push_back(file);
+			}
+		}
+		return true;
+	}
 
-		const std::string source = stream.str();
+	static const GLuint compileShader(const char* const filename, const std::string& source, GLenum type)
+	{
 		const GLchar* source_cstr = source.c_str();
 		const GLuint shader = glCreateShader(type);
 		glShaderSource(shader, 1, &source_cstr, NULL);
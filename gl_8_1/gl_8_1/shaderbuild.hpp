@@ -0,0 +1,276 @@
+#ifndef CG_SHADERBUILD_H_
+#define CG_SHADERBUILD_H_
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "programcache.hpp"
+#include "shader.hpp"
+
+// GL_KHR_parallel_shader_compile, same value in GL_ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace cg
+{
+
+/* A shader program built without blocking the frame loop, a future of a Shader.
+ * The stage files are read on a worker thread. Ready(), polled once per frame, then submits
+ * the compiles of all stages and the link without querying any status, and collects the
+ * result on a later call: once the driver reports completion with GL_KHR_parallel_shader_compile,
+ * on the next call without it. Starting the builds of all programs before polling any of them
+ * lets the driver compile them in parallel instead of one after the other.
+ * Binaries are looked up in & stored to the ProgramCache under the keys Shader::Create() uses.
+ */
+class ShaderBuild
+{
+	struct Stage
+	{
+		ShaderSource file;
+		std::string source;
+		GLuint shader;
+	};
+
+	enum class State { Reading, Compiling, Done };
+
+	std::vector<Stage> stages;
+	std::vector<std::string> defines;
+	std::vector<std::string> files; // read by the stages
+	std::future<bool> reading;      // every stage read
+	State state;
+	uint64_t cacheKey;
+	GLuint program;
+	std::unique_ptr<Shader> result;
+
+	ShaderBuild(const ShaderBuild&) = delete;
+	ShaderBuild& operator=(const ShaderBuild&) = delete;
+
+	ShaderBuild(const std::vector<ShaderSource>& sources, const std::vector<std::string>& defines) :
+		defines(defines), state(State::Reading), cacheKey(0), program(0)
+	{
+		for (const ShaderSource& source : sources) {
+			stages.push_back(Stage{ source, "", 0 });
+		}
+		reading = std::async(std::launch::async, [this] {
+			for (Stage& stage : stages) {
+				if (!Shader::readSource(stage.file.filename, this->defines, stage.source, files)) {
+					return false;
+				}
+			}
+			return true;
+		});
+	}
+
+public:
+	// Waits for the files being read, drops a program being compiled
+	~ShaderBuild()
+	{
+		if (reading.valid()) {
+			reading.wait();
+		}
+		if (state == State::Compiling) {
+			DeleteObjects();
+		}
+	}
+
+	static std::unique_ptr<ShaderBuild> Create(const char* const vertexFilename, const char* const fragmentFilename)
+	{
+		return Create({ { vertexFilename, GL_VERTEX_SHADER }, { fragmentFilename, GL_FRAGMENT_SHADER } });
+	}
+
+	static std::unique_ptr<ShaderBuild> Create(const char* const vertexFilename, const char* const fragmentFilename, const char* const tcsFilename, const char* const tesFilename)
+	{
+		return Create({
+			{ vertexFilename, GL_VERTEX_SHADER },
+			{ fragmentFilename, GL_FRAGMENT_SHADER },
+			{ tcsFilename, GL_TESS_CONTROL_SHADER },
+			{ tesFilename, GL_TESS_EVALUATION_SHADER }
+		});
+	}
+
+	/* The program of these files, every stage with the defines ("NAME" or "NAME value").
+	 * Shader::Sources() & Shader::Defines() to build a program again.
+	 */
+	static std::unique_ptr<ShaderBuild> Create(const std::vector<ShaderSource>& sources, const std::vector<std::string>& defines = {})
+	{
+		return std::unique_ptr<ShaderBuild>(new ShaderBuild(sources, defines));
+	}
+
+	/* Advance the build without waiting, true once Get() returns at once.
+	 * On the render thread, with the context current.
+	 */
+	bool Ready()
+	{
+		if (state == State::Reading) {
+			if (reading.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				return false;
+			}
+			Submit();
+			return state == State::Done;
+		}
+		if (state == State::Compiling) {
+			if (ParallelCompile()) {
+				GLint complete = GL_FALSE;
+				glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+				if (!complete) {
+					return false;
+				}
+			}
+			Finish();
+		}
+		return true;
+	}
+
+	/* The built program, waiting for the build to end.
+	 * nullptr when it failed, or when taken by a previous call.
+	 */
+	std::unique_ptr<Shader> Get()
+	{
+		if (state == State::Reading) {
+			reading.wait();
+			Submit();
+		}
+		if (state == State::Compiling) {
+			Finish();
+		}
+		return std::move(result);
+	}
+
+private:
+	// Whether the driver compiles in the background & reports when it is done
+	static bool ParallelCompile()
+	{
+		static const bool supported = [] {
+			GLint extensionNum = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &extensionNum);
+			for (GLint i = 0; i < extensionNum; ++i) {
+				const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+				if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0) {
+					return true;
+				}
+			}
+			return false;
+		}();
+		return supported;
+	}
+
+	// Name of a stage in the program cache key, the one Shader::Create() uses
+	static const char* StageName(GLenum type)
+	{
+		switch (type) {
+		case GL_VERTEX_SHADER:
+			return "vertex";
+		case GL_FRAGMENT_SHADER:
+			return "fragment";
+		case GL_TESS_CONTROL_SHADER:
+			return "tcs";
+		case GL_TESS_EVALUATION_SHADER:
+			return "tes";
+		default:
+			return "other";
+		}
+	}
+
+	std::vector<ShaderSource> Sources() const
+	{
+		std::vector<ShaderSource> sources;
+		for (const Stage& stage : stages) {
+			sources.push_back(stage.file);
+		}
+		return sources;
+	}
+
+	// Issue the compiles & the link, or load the program from the cache
+	void Submit()
+	{
+		if (!reading.get()) {
+			state = State::Done;
+			return;
+		}
+
+		// a program built from the same sources before is loaded from the cache
+		std::vector<std::string> keyParts;
+		for (const Stage& stage : stages) {
+			keyParts.push_back(StageName(stage.file.type));
+			keyParts.push_back(stage.source);
+		}
+		cacheKey = ProgramCache::Key(keyParts);
+		program = ProgramCache::Load(cacheKey);
+		if (program != 0) {
+			result.reset(new Shader(program, Sources(), defines, files));
+			program = 0;
+			state = State::Done;
+			return;
+		}
+
+		program = glCreateProgram();
+		for (Stage& stage : stages) {
+			const GLchar* source = stage.source.c_str();
+			stage.shader = glCreateShader(stage.file.type);
+			glShaderSource(stage.shader, 1, &source, NULL);
+			glCompileShader(stage.shader);
+			glAttachShader(program, stage.shader);
+		}
+		ProgramCache::Prepare(program);
+		glLinkProgram(program);
+		state = State::Compiling;
+	}
+
+	// Check the link, reporting the stage which did not compile if any
+	void Finish()
+	{
+		state = State::Done;
+		GLint success;
+		const GLsizei logLen = 512;
+		GLchar infoLog[logLen];
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			bool compiled = true;
+			for (const Stage& stage : stages) {
+				glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &success);
+				if (!success) {
+					glGetShaderInfoLog(stage.shader, logLen, NULL, infoLog);
+					std::cerr << "Shader: Shader file '" << stage.file.filename << "' compile error: " << infoLog << std::endl;
+					compiled = false;
+				}
+			}
+			if (compiled) {
+				glGetProgramInfoLog(program, logLen, NULL, infoLog);
+				std::cerr << "Link Shader error: " << infoLog << std::endl;
+			}
+			DeleteObjects();
+			return;
+		}
+		ProgramCache::Store(cacheKey, program);
+
+		// release input shaders
+		for (Stage& stage : stages) {
+			glDeleteShader(stage.shader);
+			stage.shader = 0;
+		}
+		result.reset(new Shader(program, Sources(), defines, files));
+		program = 0;
+	}
+
+	void DeleteObjects()
+	{
+		for (Stage& stage : stages) {
+			glDeleteShader(stage.shader);
+			stage.shader = 0;
+		}
+		glDeleteProgram(program);
+		program = 0;
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_SHADERBUILD_H_ */
@@ -0,0 +1,218 @@
+#ifndef CG_SHADERPREPROCESSOR_H_
+#define CG_SHADERPREPROCESSOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace cg
+{
+
+/* Turns a GLSL file into the source of one shader stage:
+ *  - #include "file" lines are replaced by the file, found next to the file including it.
+ *    A file is included once per stage, later includes of it are dropped, so shared files
+ *    need no include guards and cannot recurse.
+ *  - defines, "NAME" or "NAME value", are inserted as #define lines after #version, to build
+ *    variants of one file.
+ *  - #line directives keep the line numbers of compile errors, the source string number
+ *    being the index of the file in the files list Process() returns.
+ * Files are split into text & includes once and kept in memory, keyed by path and checked
+ * against the modification time & size on disk, so dozens of variants of the same files
+ * read each of them once, and an edited file is read again. Thread safe.
+ */
+class ShaderPreprocessor
+{
+	// a file split at its #include lines
+	struct ParsedFile
+	{
+		int64_t modified;
+		int64_t size;
+		std::vector<std::string> texts;    // texts[i] precedes includes[i]
+		std::vector<std::string> includes; // paths, resolved
+		std::vector<int> resumeLines;      // line after includes[i]
+	};
+
+public:
+	/* The source of filename ready to compile.
+	 * files: if not null, receives the paths of filename and of every file it includes
+	 */
+	static bool Process(const std::string& filename, const std::vector<std::string>& defines, std::string& source, std::vector<std::string>* files = nullptr)
+	{
+		std::lock_guard<std::mutex> lock(Mutex());
+		std::vector<std::string> included;
+		std::ostringstream out;
+		if (!Append(filename, defines, out, included)) {
+			return false;
+		}
+		source = out.str();
+		if (files != nullptr) {
+			*files = included;
+		}
+		return true;
+	}
+
+private:
+	static std::mutex& Mutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static std::map<std::string, ParsedFile>& Files()
+	{
+		static std::map<std::string, ParsedFile> files;
+		return files;
+	}
+
+	// Write a file with its includes to out, defines after its #version line if not empty
+	static bool Append(const std::string& path, const std::vector<std::string>& defines, std::ostringstream& out, std::vector<std::string>& included)
+	{
+		const ParsedFile* file = Parse(path);
+		if (file == nullptr) {
+			return false;
+		}
+		const int index = int(included.size());
+		included.push_back(path);
+		for (size_t i = 0; i < file->texts.size(); ++i) {
+			if (i == 0 && !defines.empty()) {
+				AppendDefines(file->texts[0], defines, index, out);
+			} else {
+				out << file->texts[i];
+			}
+			if (i < file->includes.size()) {
+				const std::string& include = file->includes[i];
+				if (std::find(included.begin(), included.end(), include) == included.end()) {
+					out << "#line 1 " << included.size() << "\n";
+					if (!Append(include, std::vector<std::string>(), out, included)) {
+						std::cerr << "Shader: included from '" << path << "'" << std::endl;
+						return false;
+					}
+				}
+				out << "#line " << file->resumeLines[i] << " " << index << "\n";
+			}
+		}
+		return true;
+	}
+
+	static void AppendDefines(const std::string& text, const std::vector<std::string>& defines, int index, std::ostringstream& out)
+	{
+		// #version must stay the first directive, the defines go after its line
+		size_t split = 0;
+		int line = 1;
+		for (size_t start = 0, number = 1; start < text.size(); ++number) {
+			size_t end = text.find('\n', start);
+			end = end == std::string::npos ? text.size() : end + 1;
+			const size_t directive = text.find_first_not_of(" \t", start);
+			if (directive < end && text.compare(directive, 8, "#version") == 0) {
+				split = end;
+				line = int(number) + 1;
+				break;
+			}
+			start = end;
+		}
+		out << text.substr(0, split);
+		for (const std::string& define : defines) {
+			out << "#define " << define << "\n";
+		}
+		out << "#line " << line << " " << index << "\n";
+		out << text.substr(split);
+	}
+
+	// The file at path, parsed again if it changed on disk
+	static const ParsedFile* Parse(const std::string& path)
+	{
+		struct stat status;
+		if (stat(path.c_str(), &status) != 0) {
+			std::cerr << "Shader: open file '" << path << "' error" << std::endl;
+			return nullptr;
+		}
+#ifdef __linux__
+		// nanoseconds, files saved within a second differ
+		const int64_t modified = int64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#else
+		const int64_t modified = int64_t(status.st_mtime);
+#endif
+		const int64_t size = int64_t(status.st_size);
+
+		std::map<std::string, ParsedFile>& files = Files();
+		const auto cached = files.find(path);
+		if (cached != files.end() && cached->second.modified == modified && cached->second.size == size) {
+			return &cached->second;
+		}
+
+		std::ifstream fin(path, std::ios::in | std::ios::binary);
+		if (!fin) {
+			std::cerr << "Shader: open file '" << path << "' error" << std::endl;
+			return nullptr;
+		}
+		std::ostringstream content;
+		content << fin.rdbuf();
+		if (fin.bad()) {
+			std::cerr << "Shader: read file '" << path << "' error" << std::endl;
+			return nullptr;
+		}
+
+		ParsedFile& file = files[path];
+		file = ParsedFile{ modified, size, {}, {}, {} };
+		const std::string directory = Directory(path);
+		std::istringstream lines(content.str());
+		std::string text;
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(lines, line)) {
+			++lineNumber;
+			std::string include;
+			if (IncludeOf(line, include)) {
+				file.texts.push_back(text);
+				file.includes.push_back(directory.empty() ? include : directory + "/" + include);
+				file.resumeLines.push_back(lineNumber + 1);
+				text.clear();
+			} else {
+				text += line;
+				text += '\n';
+			}
+		}
+		file.texts.push_back(text);
+		return &file;
+	}
+
+	// Whether line is #include "file", and the file
+	static bool IncludeOf(const std::string& line, std::string& include)
+	{
+		const size_t hash = line.find_first_not_of(" \t");
+		if (hash == std::string::npos || line[hash] != '#') {
+			return false;
+		}
+		const size_t directive = line.find_first_not_of(" \t", hash + 1);
+		if (directive == std::string::npos || line.compare(directive, 7, "include") != 0) {
+			return false;
+		}
+		const size_t open = line.find('"', directive + 7);
+		const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+		if (close == std::string::npos) {
+			return false;
+		}
+		include = line.substr(open + 1, close - open - 1);
+		return true;
+	}
+
+	// The directory part of a path, empty for a bare file name
+	static std::string Directory(const std::string& path)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash);
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_SHADERPREPROCESSOR_H_ */
@@ -0,0 +1,114 @@
+#ifndef CG_SHADERRELOADER_H_
+#define CG_SHADERRELOADER_H_
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "filewatcher.hpp"
+#include "shader.hpp"
+#include "shaderbuild.hpp"
+
+namespace cg
+{
+
+/* Rebuilds shader programs when one of their files, or of the files they include, is
+ * saved, without restarting.
+ * A rebuild is a ShaderBuild: files are read on a worker thread and the driver compiles
+ * while the old program keeps drawing. Only a program which links replaces the old one,
+ * inside the same Shader, so the rest of the code holds on to it unchanged. A file
+ * saved again during a rebuild starts another one once it ends.
+ * The frame loop waits on the driver only without GL_KHR_parallel_shader_compile, for
+ * the time of the compile.
+ */
+class ShaderReloader
+{
+	struct Entry
+	{
+		Shader* shader;
+		std::unique_ptr<ShaderBuild> build;
+		bool changed; // while building
+	};
+
+	FileWatcher watcher;
+	std::vector<Entry> entries;
+	int reloadNum;
+
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+public:
+	ShaderReloader() : reloadNum(0) {}
+
+	// Programs swapped in since the start
+	int ReloadNum() const { return reloadNum; }
+
+	// Watch the files of shader, which must stay alive while Update() is called
+	void Watch(Shader& shader)
+	{
+		entries.push_back(Entry{ &shader, nullptr, false });
+		WatchFiles(shader);
+	}
+
+	// Once per frame on the render thread: start the rebuilds of changed files, swap in the finished ones
+	void Update()
+	{
+		for (const std::string& file : watcher.Changed()) {
+			for (Entry& entry : entries) {
+				// changed files come normalized, the shader's as it read them
+				const std::vector<std::string>& files = entry.shader->Files();
+				if (std::none_of(files.begin(), files.end(), [&file](const std::string& read) { return FileWatcher::Normalize(read) == file; })) {
+					continue;
+				}
+				if (entry.build != nullptr) {
+					entry.changed = true;
+				} else {
+					entry.build = ShaderBuild::Create(entry.shader->Sources(), entry.shader->Defines());
+				}
+			}
+		}
+
+		for (Entry& entry : entries) {
+			if (entry.build == nullptr || !entry.build->Ready()) {
+				continue;
+			}
+			std::unique_ptr<Shader> rebuilt = entry.build->Get();
+			entry.build.reset();
+			if (rebuilt != nullptr) {
+				entry.shader->Swap(*rebuilt);
+				WatchFiles(*entry.shader); // includes may have been added
+				++reloadNum;
+				std::cout << "Shader: reloaded " << Describe(*entry.shader) << std::endl;
+			} else {
+				std::cerr << "Shader: keeping the previous program of " << Describe(*entry.shader) << std::endl;
+			}
+			if (entry.changed) {
+				entry.changed = false;
+				entry.build = ShaderBuild::Create(entry.shader->Sources(), entry.shader->Defines());
+			}
+		}
+	}
+
+private:
+	void WatchFiles(const Shader& shader)
+	{
+		for (const std::string& file : shader.Files()) {
+			watcher.Add(file);
+		}
+	}
+
+	static std::string Describe(const Shader& shader)
+	{
+		std::string files;
+		for (const ShaderSource& source : shader.Sources()) {
+			files += (files.empty() ? "'" : ", '") + source.filename + "'";
+		}
+		return files;
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_SHADERRELOADER_H_ */
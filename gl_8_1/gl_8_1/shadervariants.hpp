@@ -0,0 +1,163 @@
+#ifndef CG_SHADERVARIANTS_H_
+#define CG_SHADERVARIANTS_H_
+
+#include <array>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "shader.hpp"
+#include "shaderbuild.hpp"
+#include "shaderreloader.hpp"
+
+namespace cg
+{
+
+/* The programs built from one set of shader files with different features, requested by
+ * a bitmask of ShaderVariants::Feature.
+ * Every feature set in a variant is #defined in all its stages, and TESSELLATION adds the
+ * tessellation stages. Variants are built the first time they are requested, or ahead of
+ * time in the background with Prewarm(). Features the files do not support are masked off,
+ * so requests differing only by those share one program.
+ * The bitmask is the index into a flat table of all variants: combine the features in a
+ * constexpr and a lookup is one AND and one array access, no string is hashed.
+ */
+class ShaderVariants
+{
+public:
+	enum Feature : unsigned
+	{
+		TESSELLATION = 1u << 0, // tcs & tes stages, drawn as patches
+		TEXTURED = 1u << 1,     // sampled from ourTexture
+		FEATURE_NUM = 2
+	};
+
+private:
+	static constexpr unsigned VARIANT_NUM = 1u << FEATURE_NUM;
+
+	struct Variant
+	{
+		std::unique_ptr<Shader> shader;
+		std::unique_ptr<ShaderBuild> build; // in the background, until taken
+		bool failed;
+	};
+
+	std::string vertexFilename;
+	std::string fragmentFilename;
+	std::string tcsFilename;
+	std::string tesFilename;
+	unsigned supported; // features the files implement
+	ShaderReloader* reloader;
+	std::array<Variant, VARIANT_NUM> variants;
+	int buildNum;
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+public:
+	/* tcsFilename & tesFilename: for TESSELLATION, may be null without it in supported
+	 * reloader: if not null, watches the files of every variant built
+	 */
+	ShaderVariants(const char* vertexFilename, const char* fragmentFilename, const char* tcsFilename, const char* tesFilename, unsigned supported, ShaderReloader* reloader = nullptr) :
+		vertexFilename(vertexFilename), fragmentFilename(fragmentFilename),
+		tcsFilename(tcsFilename != nullptr ? tcsFilename : ""), tesFilename(tesFilename != nullptr ? tesFilename : ""),
+		supported(supported & (VARIANT_NUM - 1)), reloader(reloader), buildNum(0)
+	{
+		for (Variant& variant : variants) {
+			variant.failed = false;
+		}
+	}
+
+	// Programs built so far, variants sharing one counted once
+	int BuildNum() const { return buildNum; }
+
+	// The variant of features, built now if it is not yet; nullptr if it fails to build
+	Shader* Get(unsigned features)
+	{
+		Variant& variant = variants[features & supported];
+		if (variant.shader == nullptr && !variant.failed) {
+			if (variant.build == nullptr) {
+				Start(features & supported);
+			}
+			Take(variant);
+		}
+		return variant.shader.get();
+	}
+
+	// The variant of features if built, else nullptr while it is built in the background
+	Shader* TryGet(unsigned features)
+	{
+		Variant& variant = variants[features & supported];
+		if (variant.shader == nullptr && !variant.failed) {
+			if (variant.build == nullptr) {
+				Start(features & supported);
+			}
+			if (variant.build->Ready()) {
+				Take(variant);
+			}
+		}
+		return variant.shader.get();
+	}
+
+	// Start building the variant of features in the background
+	void Prewarm(unsigned features)
+	{
+		Variant& variant = variants[features & supported];
+		if (variant.shader == nullptr && variant.build == nullptr && !variant.failed) {
+			Start(features & supported);
+		}
+	}
+
+	// Once per frame: advance the background builds
+	void Update()
+	{
+		for (Variant& variant : variants) {
+			if (variant.build != nullptr && variant.build->Ready()) {
+				Take(variant);
+			}
+		}
+	}
+
+private:
+	void Start(unsigned key)
+	{
+		std::vector<ShaderSource> sources = {
+			{ vertexFilename, GL_VERTEX_SHADER },
+			{ fragmentFilename, GL_FRAGMENT_SHADER }
+		};
+		if (key & TESSELLATION) {
+			sources.push_back(ShaderSource{ tcsFilename, GL_TESS_CONTROL_SHADER });
+			sources.push_back(ShaderSource{ tesFilename, GL_TESS_EVALUATION_SHADER });
+		}
+		std::vector<std::string> defines;
+		if (key & TESSELLATION) {
+			defines.push_back("TESSELLATION");
+		}
+		if (key & TEXTURED) {
+			defines.push_back("TEXTURED");
+		}
+		variants[key].build = ShaderBuild::Create(sources, defines);
+	}
+
+	void Take(Variant& variant)
+	{
+		variant.shader = variant.build->Get();
+		variant.build.reset();
+		if (variant.shader == nullptr) {
+			variant.failed = true;
+			std::cerr << "ShaderVariants: variant " << (&variant - variants.data()) << " of '" << vertexFilename << "' failed to build" << std::endl;
+			return;
+		}
+		++buildNum;
+		if (reloader != nullptr) {
+			reloader->Watch(*variant.shader);
+		}
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_SHADERVARIANTS_H_ */
@@ -0,0 +1,88 @@
+#ifndef CG_CAMERABUFFER_H_
+#define CG_CAMERABUFFER_H_
+
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "camera.hpp"
+#include "shader.hpp"
+
+namespace cg
+{
+
+/* The camera matrices of a frame in a uniform buffer shared by all programs.
+ * Filled once per frame and bound to BINDING, programs read it through the block
+ *
+ *   layout(std140) uniform Camera
+ *   {
+ *       mat4 view;
+ *       mat4 projection;
+ *       mat4 viewProjection;
+ *       vec4 cameraPosition; // w = 1
+ *   };
+ *
+ * instead of a view & a projection uniform set in every program. Shader binds the block to
+ * BINDING in programs created after this buffer, for GLSL before 4.20 without layout(binding).
+ */
+class CameraBuffer
+{
+	// std140: mat4 are 4 vec4 columns, every member 16-byte aligned, as in C++
+	struct Block
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 viewProjection;
+		glm::vec4 position;
+	};
+	static_assert(sizeof(Block) == 3 * 64 + 16, "Block must match the std140 layout");
+
+	GLuint UBO;
+	Block block;
+	bool uploaded; // block is in the buffer
+
+	CameraBuffer(const CameraBuffer&) = delete;
+	CameraBuffer& operator=(const CameraBuffer&) = delete;
+
+public:
+	static constexpr GLuint BINDING = 0;
+
+	CameraBuffer() : uploaded(false)
+	{
+		Shader::BindUniformBlock("Camera", BINDING);
+		glGenBuffers(1, &UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, UBO);
+	}
+
+	~CameraBuffer()
+	{
+		glDeleteBuffers(1, &UBO);
+	}
+
+	// Fill the buffer for this frame, nothing is uploaded if the camera did not change
+	void Update(const Camera& camera, const glm::mat4& projection)
+	{
+		Block frame;
+		frame.view = camera.ViewMatrix();
+		frame.projection = projection;
+		frame.viewProjection = projection * frame.view;
+		frame.position = glm::vec4(camera.Position(), 1.0f);
+		if (uploaded && memcmp(&frame, &block, sizeof(Block)) == 0) {
+			return;
+		}
+		block = frame;
+		uploaded = true;
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+};
+
+} /* namespace cg */
+
+#endif /* CG_CAMERABUFFER_H_ */
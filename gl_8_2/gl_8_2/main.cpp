@@ -16,7 +16,11 @@
 
 // Other includes
 #include "shader.hpp"
+#include "shaderreloader.hpp"
+#include "shadervariants.hpp"
 #include "camera.hpp"
+#include "camerabuffer.hpp"
+#include "benchmark.hpp"
 
 using namespace cg;
 
@@ -45,10 +49,13 @@ float level = 5.0f;
 int drawMode = 1;
 
 // The MAIN function, from here we start the application and run the game loop
-int main()
+int main(int argc, char* argv[])
 {
+    // Headless run of a fixed number of frames with --benchmark
+    Benchmark benchmark(argc, argv, "gl_8_2");
+
     // Init GLFW
-    glfwInit();
+    benchmark.Init();
     // Set all the required options for GLFW
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
@@ -73,10 +80,27 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    if (!benchmark.Attach(window)) {
+        return -1;
+    }
 
-    // Build and compile our shader program
-    auto ourShader = Shader::Create("main.vert.glsl", "main.frag.glsl", "main.tcs.glsl", "main.tes.glsl");
-    auto ourShader2 = Shader::Create("main.vert.glsl", "main.frag2.glsl");
+    // View & projection of each frame, read by all programs; created first so they bind to it
+    CameraBuffer cameraBuffer;
+    // Saved shader files are built again & swapped in while running
+    ShaderReloader shaderReloader;
+    // The variants of our shader program: the textured surface & the control points
+    constexpr unsigned SURFACE = ShaderVariants::TESSELLATION | ShaderVariants::TEXTURED;
+    constexpr unsigned CONTROL_POINTS = 0;
+    ShaderVariants shaders("main.vert.glsl", "main.frag.glsl", "main.tcs.glsl", "main.tes.glsl", SURFACE, &shaderReloader);
+    // Build both in the background, at once, and wait for them before the first frame
+    shaders.Prewarm(SURFACE);
+    shaders.Prewarm(CONTROL_POINTS);
+    Shader* ourShader = shaders.Get(SURFACE);
+    Shader* ourShader2 = shaders.Get(CONTROL_POINTS);
+    if (ourShader == nullptr || ourShader2 == nullptr) {
+        std::cerr << "Error creating Shader Program" << std::endl;
+        return -1;
+    }
 
     // Set up vertex data (and buffer(s)) and attribute pointers
     // 16 control points
@@ -135,34 +159,37 @@ int main()
     glBindTexture(GL_TEXTURE_2D, 0);
 
     // Game loop
-    while (!glfwWindowShouldClose(window))     {
-        float currentFrame = (float)glfwGetTime();
+    while (benchmark.Running(window))     {
+        benchmark.Phase("Events");
+        float currentFrame = (float)benchmark.Time();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         // Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
         glfwPollEvents();
+        benchmark.Phase("Update");
         changeScale(deltaTime);
         moveCamera(deltaTime);
 
         // Render
+        benchmark.Phase("Draw");
         // Clear the colorbuffer
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
+        shaderReloader.Update();
+
         glm::mat4 model(1);
-        glm::mat4 view = camera.ViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom()), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
+        cameraBuffer.Update(camera, projection);
 
         // Activate shader
         ourShader->Use();
-        glUniform1f(glGetUniformLocation(ourShader->Program(), "uOuter02"), level);
-        glUniform1f(glGetUniformLocation(ourShader->Program(), "uOuter13"), level);
-        glUniform1f(glGetUniformLocation(ourShader->Program(), "uInner0"), level);
-        glUniform1f(glGetUniformLocation(ourShader->Program(), "uInner1"), level);
-        glUniformMatrix4fv(glGetUniformLocation(ourShader->Program(), "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(ourShader->Program(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(ourShader->Program(), "model"), 1, GL_FALSE, glm::value_ptr(model));
+        ourShader->Set("uOuter02", level);
+        ourShader->Set("uOuter13", level);
+        ourShader->Set("uInner0", level);
+        ourShader->Set("uInner1", level);
+        ourShader->Set("model", model);
         glBindTexture(GL_TEXTURE_2D, texture);
 
         // Draw bezier surface
@@ -183,20 +210,19 @@ int main()
 
         // Draw control points
         ourShader2->Use();
-        glUniformMatrix4fv(glGetUniformLocation(ourShader2->Program(), "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(ourShader2->Program(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(ourShader2->Program(), "model"), 1, GL_FALSE, glm::value_ptr(model));
+        ourShader2->Set("model", model);
         glPointSize(10.0f);
         glBindVertexArray(VAO);
         glDrawArrays(GL_POINTS, 0, 16);
         glBindVertexArray(0);
 
         // Swap the screen buffers
-        glfwSwapBuffers(window);
+        benchmark.SwapBuffers(window);
     }
     // Properly de-allocate all resources once they've outlived their purpose
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
+    benchmark.Report();
     // Terminate GLFW, clearing any resources allocated by GLFW.
     glfwTerminate();
     return 0;
@@ -1,13 +1,18 @@
 #version 410 core
 
+#ifdef TEXTURED
 in vec2 TexCoord;
 
-out vec4 color;
-
 uniform sampler2D ourTexture;
+#endif
+
+out vec4 color;
 
 void main()
 {
+#ifdef TEXTURED
     color = texture(ourTexture, TexCoord);
-    //color = vec4(1.0f, 0.5f, 0.2f, 1.0f);
+#else
+    color = vec4(1.0f, 0.5f, 0.2f, 1.0f);
+#endif
 }
@@ -1,8 +0,0 @@
-#version 410 core
-
-out vec4 color;
-
-void main()
-{
-    color = vec4(1.0f, 0.5f, 0.2f, 1.0f);
-}
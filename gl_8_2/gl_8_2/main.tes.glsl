@@ -4,6 +4,8 @@ layout(quads, equal_spacing, ccw) in;
 
 out vec2 TexCoord;
 
+#include "bezier.glsl"
+
 void main() {
 	vec4 p00 = gl_in[ 0].gl_Position;
     vec4 p10 = gl_in[ 1].gl_Position;
@@ -26,14 +28,8 @@ void main() {
     TexCoord = vec2(u, v);
     // Computing the Position, given a u and v
 	// the basis functions:
-    float bu0 = (1.-u) * (1.-u) * (1.-u);
-    float bu1 = 3. * u * (1.-u) * (1.-u);
-    float bu2 = 3. * u * u * (1.-u);
-    float bu3 = u * u * u;
-    float bv0 = (1.-v) * (1.-v) * (1.-v);
-    float bv1 = 3. * v * (1.-v) * (1.-v);
-    float bv2 = 3. * v * v * (1.-v);
-    float bv3 = v * v * v;
+    vec4 bu = bernstein(u);
+    vec4 bv = bernstein(v);
     // finally, we get to compute something:
-    gl_Position = bu0 * ( bv0*p00 + bv1*p01 + bv2*p02 + bv3*p03 ) + bu1 * ( bv0*p10 + bv1*p11 + bv2*p12 + bv3*p13 ) + bu2 * ( bv0*p20 + bv1*p21 + bv2*p22 + bv3*p23 ) + bu3 * ( bv0*p30 + bv1*p31 + bv2*p32 + bv3*p33 );
+    gl_Position = bu.x * ( bv.x*p00 + bv.y*p01 + bv.z*p02 + bv.w*p03 ) + bu.y * ( bv.x*p10 + bv.y*p11 + bv.z*p12 + bv.w*p13 ) + bu.z * ( bv.x*p20 + bv.y*p21 + bv.z*p22 + bv.w*p23 ) + bu.w * ( bv.x*p30 + bv.y*p31 + bv.z*p32 + bv.w*p33 );
 }